@@ -0,0 +1,211 @@
+#include "animation.h"
+#include "mat4_kernels.h"
+
+#include <tiny_gltf.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+void JointPoses::resize(size_t jointCount)
+{
+	translations.resize(jointCount, glm::vec3(0.0f));
+	rotations.resize(jointCount, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	scales.resize(jointCount, glm::vec3(1.0f));
+}
+
+// Float elements of an accessor, componentCount per element
+static bool ReadFloats(const tinygltf::Model &model, int accessorIndex, int componentCount, std::vector<float> &out)
+{
+	const tinygltf::Accessor &accessor = model.accessors[accessorIndex];
+	if (accessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT || accessor.bufferView < 0) {
+		return false;
+	}
+	const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
+	const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
+	const unsigned char *data = &buffer.data[bufferView.byteOffset + accessor.byteOffset];
+	int stride = accessor.ByteStride(bufferView);
+
+	out.resize(accessor.count * componentCount);
+	for (size_t i = 0; i < accessor.count; i++) {
+		memcpy(&out[i * componentCount], data + i * stride, componentCount * sizeof(float));
+	}
+	return true;
+}
+
+void CompileAnimationClip(const tinygltf::Model &model, const tinygltf::Animation &animation,
+	const std::vector<int> &jointNodes, AnimationClip &clip)
+{
+	clip = AnimationClip();
+	std::vector<int> nodeJoints(model.nodes.size(), -1);
+	for (size_t j = 0; j < jointNodes.size(); j++) {
+		nodeJoints[jointNodes[j]] = (int)j;
+	}
+
+	std::vector<float> times, values;
+	for (size_t c = 0; c < animation.channels.size(); c++) {
+		const tinygltf::AnimationChannel &channel = animation.channels[c];
+		const tinygltf::AnimationSampler &sampler = animation.samplers[channel.sampler];
+		if (channel.target_node < 0 || nodeJoints[channel.target_node] < 0) {
+			continue;
+		}
+
+		// The only string compares, once per channel at load time
+		int components;
+		unsigned char path;
+		if (channel.target_path == "translation") {
+			path = AnimationTranslation;
+			components = 3;
+		}
+		else if (channel.target_path == "rotation") {
+			path = AnimationRotation;
+			components = 4;
+		}
+		else if (channel.target_path == "scale") {
+			path = AnimationScale;
+			components = 3;
+		}
+		else {
+			std::cout << "Unsupported animation path " << channel.target_path << std::endl;
+			continue;
+		}
+
+		if (!ReadFloats(model, sampler.input, 1, times) || !ReadFloats(model, sampler.output, components, values) ||
+			times.empty()) {
+			std::cout << "Unsupported animation sampler " << channel.sampler << std::endl;
+			continue;
+		}
+
+		// Cubic splines store in-tangent, value, out-tangent per key; keep the values
+		bool cubic = sampler.interpolation == "CUBICSPLINE";
+		size_t keyCount = times.size();
+		if (values.size() != keyCount * components * (cubic ? 3 : 1)) {
+			std::cout << "Animation sampler " << channel.sampler << " has mismatched keys" << std::endl;
+			continue;
+		}
+
+		clip.paths.push_back(path);
+		clip.interpolations.push_back(sampler.interpolation == "STEP" ? AnimationStep : AnimationLinear);
+		clip.targets.push_back(nodeJoints[channel.target_node]);
+		clip.keyOffsets.push_back((int)clip.times.size());
+		clip.keyCounts.push_back((int)keyCount);
+		for (size_t k = 0; k < keyCount; k++) {
+			const float *value = &values[(cubic ? 3 * k + 1 : k) * components];
+			clip.times.push_back(times[k]);
+			clip.values.push_back(glm::vec4(value[0], value[1], value[2], components == 4 ? value[3] : 0.0f));
+		}
+		clip.duration = std::max(clip.duration, times.back());
+	}
+}
+
+void RestJointPoses(const tinygltf::Model &model, const std::vector<int> &jointNodes, JointPoses &poses)
+{
+	poses.translations.clear();
+	poses.rotations.clear();
+	poses.scales.clear();
+	poses.resize(jointNodes.size());
+	for (size_t j = 0; j < jointNodes.size(); j++) {
+		const tinygltf::Node &node = model.nodes[jointNodes[j]];
+		if (node.matrix.size() == 16) {
+			// Split into translation, scale and the rotation left over; no shear
+			glm::mat4 m;
+			for (int i = 0; i < 16; i++) {
+				m[i / 4][i % 4] = (float)node.matrix[i];
+			}
+			glm::vec3 scale(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+			glm::mat3 rotation(glm::vec3(m[0]) / scale.x, glm::vec3(m[1]) / scale.y, glm::vec3(m[2]) / scale.z);
+			poses.translations[j] = glm::vec3(m[3]);
+			poses.rotations[j] = glm::quat_cast(rotation);
+			poses.scales[j] = scale;
+			continue;
+		}
+		if (node.translation.size() == 3) {
+			poses.translations[j] = glm::vec3(node.translation[0], node.translation[1], node.translation[2]);
+		}
+		if (node.rotation.size() == 4) {
+			poses.rotations[j] = glm::quat(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
+		}
+		if (node.scale.size() == 3) {
+			poses.scales[j] = glm::vec3(node.scale[0], node.scale[1], node.scale[2]);
+		}
+	}
+}
+
+static glm::quat ToQuat(const glm::vec4 &xyzw)
+{
+	return glm::quat(xyzw.w, xyzw.x, xyzw.y, xyzw.z);
+}
+
+void SampleAnimationClip(const AnimationClip &clip, float time, AnimationCursor &cursor, JointPoses &poses)
+{
+	size_t trackCount = clip.trackCount();
+	if (trackCount == 0) {
+		return;
+	}
+	float clipTime = clip.duration > 0.0f ? std::fmod(time, clip.duration) : 0.0f;
+	if (clipTime < 0.0f) {
+		clipTime += clip.duration;
+	}
+
+	// Moving backwards, e.g. the clip looped: search forward from the start again
+	if (cursor.keys.size() != trackCount || clipTime < cursor.lastTime) {
+		cursor.keys.assign(trackCount, 0);
+	}
+	cursor.lastTime = clipTime;
+	if (cursor.slerpJoints.size() != trackCount) {
+		cursor.slerpFrom.resize(trackCount);
+		cursor.slerpTo.resize(trackCount);
+		cursor.slerpWeights.resize(trackCount);
+		cursor.slerpResults.resize(trackCount);
+		cursor.slerpJoints.resize(trackCount);
+	}
+	size_t slerpCount = 0;
+
+	for (size_t i = 0; i < trackCount; i++) {
+		const float *times = &clip.times[clip.keyOffsets[i]];
+		const glm::vec4 *values = &clip.values[clip.keyOffsets[i]];
+		int last = clip.keyCounts[i] - 1;
+
+		// Advance to the key at or before clipTime
+		int key = cursor.keys[i];
+		while (key < last && times[key + 1] <= clipTime) {
+			key++;
+		}
+		cursor.keys[i] = key;
+
+		glm::vec4 a = values[key];
+		float t = 0.0f;
+		if (key < last && clipTime > times[key] && clip.interpolations[i] == AnimationLinear) {
+			t = (clipTime - times[key]) / (times[key + 1] - times[key]);
+		}
+
+		int joint = clip.targets[i];
+		switch (clip.paths[i]) {
+		case AnimationTranslation:
+			poses.translations[joint] = glm::vec3(t > 0.0f ? glm::mix(a, values[key + 1], t) : a);
+			break;
+		case AnimationRotation:
+			if (t > 0.0f) {
+				cursor.slerpFrom[slerpCount] = ToQuat(a);
+				cursor.slerpTo[slerpCount] = ToQuat(values[key + 1]);
+				cursor.slerpWeights[slerpCount] = t;
+				cursor.slerpJoints[slerpCount] = joint;
+				slerpCount++;
+			}
+			else {
+				poses.rotations[joint] = ToQuat(a);
+			}
+			break;
+		case AnimationScale:
+			poses.scales[joint] = glm::vec3(t > 0.0f ? glm::mix(a, values[key + 1], t) : a);
+			break;
+		}
+	}
+
+	ActiveMat4Kernels().slerp(cursor.slerpFrom.data(), cursor.slerpTo.data(), cursor.slerpWeights.data(),
+		cursor.slerpResults.data(), slerpCount);
+	for (size_t i = 0; i < slerpCount; i++) {
+		poses.rotations[cursor.slerpJoints[i]] = cursor.slerpResults[i];
+	}
+}
@@ -0,0 +1,84 @@
+#ifndef _ANIMATION_H_
+#define _ANIMATION_H_
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+namespace tinygltf {
+class Model;
+struct Animation;
+}
+
+enum AnimationPath {
+	AnimationTranslation,
+	AnimationRotation,
+	AnimationScale
+};
+
+enum AnimationInterpolation {
+	AnimationLinear,	// Lerp, slerp for rotations; also used for CUBICSPLINE
+	AnimationStep
+};
+
+// Local transform of every joint as separate translation, rotation and
+// scale arrays, indexed by joint
+struct JointPoses {
+	std::vector<glm::vec3> translations;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+
+	void resize(size_t jointCount);
+};
+
+// One glTF animation resolved into flat tracks, so sampling touches no
+// strings and no glTF accessors. Track i animates one path of joint
+// targets[i] with keyCounts[i] keys starting at keyOffsets[i] in times and
+// values. Values are xyz for translation and scale, a quaternion as xyzw
+// for rotation.
+struct AnimationClip {
+	float duration;
+	std::vector<unsigned char> paths;
+	std::vector<unsigned char> interpolations;
+	std::vector<int> targets;
+	std::vector<int> keyOffsets;
+	std::vector<int> keyCounts;
+	std::vector<float> times;
+	std::vector<glm::vec4> values;
+
+	AnimationClip() : duration(0.0f) {}
+
+	size_t trackCount() const { return targets.size(); }
+};
+
+// Playback state of one clip instance: the key each track was sampled at
+// last. As long as time moves forward, finding the next key is a step or
+// two instead of a search. The rotations to interpolate are gathered into
+// the slerp arrays and blended in one batch.
+struct AnimationCursor {
+	std::vector<int> keys;
+	float lastTime;
+	std::vector<glm::quat> slerpFrom;
+	std::vector<glm::quat> slerpTo;
+	std::vector<float> slerpWeights;
+	std::vector<glm::quat> slerpResults;
+	std::vector<int> slerpJoints;
+
+	AnimationCursor() : lastTime(0.0f) {}
+};
+
+// Resolves the channels of animation. jointNodes maps each joint index to
+// its node (the skin's joints array); channels that target other nodes are
+// skipped.
+void CompileAnimationClip(const tinygltf::Model &model, const tinygltf::Animation &animation,
+	const std::vector<int> &jointNodes, AnimationClip &clip);
+
+// Rest transforms of the joint nodes, what joints without tracks keep.
+// Node matrices are split into translation, rotation and scale.
+void RestJointPoses(const tinygltf::Model &model, const std::vector<int> &jointNodes, JointPoses &poses);
+
+// Overwrites the animated paths in poses with the clip at time, which
+// wraps around the clip duration. Tracks hold their last key past their end.
+void SampleAnimationClip(const AnimationClip &clip, float time, AnimationCursor &cursor, JointPoses &poses);
+
+#endif
@@ -0,0 +1,278 @@
+#include "mat4_kernels.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MAT4_KERNELS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// glm, one element at a time
+// ---------------------------------------------------------------------------
+
+static void MultiplyGlm(const glm::mat4 *a, const int *aIndex, const glm::mat4 *b, glm::mat4 *out, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		out[i] = a[aIndex ? aIndex[i] : i] * b[i];
+	}
+}
+
+static void PropagateGlm(const int *parents, const glm::mat4 *locals, glm::mat4 *out, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		out[i] = parents[i] >= 0 ? out[parents[i]] * locals[i] : locals[i];
+	}
+}
+
+static void ComposeTRSGlm(const glm::vec3 *t, const glm::quat *r, const glm::vec3 *s, glm::mat4 *out, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), t[i]);
+		transform *= glm::mat4_cast(r[i]);
+		out[i] = glm::scale(transform, s[i]);
+	}
+}
+
+static void SlerpGlm(const glm::quat *a, const glm::quat *b, const float *weights, glm::quat *out, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		out[i] = glm::slerp(a[i], b[i], weights[i]);
+	}
+}
+
+static const Mat4Kernels glmKernels = { "glm", MultiplyGlm, PropagateGlm, ComposeTRSGlm, SlerpGlm };
+
+// ---------------------------------------------------------------------------
+// SSE2
+// ---------------------------------------------------------------------------
+
+#ifdef MAT4_KERNELS_SSE2
+
+// Column-major like glm: each output column is the columns of a weighted by
+// the matching column of b. Reads all of a and a column of b before writing
+// that column, so out may be a or b.
+static inline void MultiplySse2(const float *a, const float *b, float *out)
+{
+	__m128 a0 = _mm_loadu_ps(a);
+	__m128 a1 = _mm_loadu_ps(a + 4);
+	__m128 a2 = _mm_loadu_ps(a + 8);
+	__m128 a3 = _mm_loadu_ps(a + 12);
+	for (int j = 0; j < 16; j += 4) {
+		__m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[j]));
+		column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[j + 1])));
+		column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[j + 2])));
+		column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[j + 3])));
+		_mm_storeu_ps(out + j, column);
+	}
+}
+
+static void MultiplySse2Batch(const glm::mat4 *a, const int *aIndex, const glm::mat4 *b, glm::mat4 *out, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		MultiplySse2(&a[aIndex ? aIndex[i] : i][0][0], &b[i][0][0], &out[i][0][0]);
+	}
+}
+
+static void PropagateSse2(const int *parents, const glm::mat4 *locals, glm::mat4 *out, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (parents[i] >= 0) {
+			MultiplySse2(&out[parents[i]][0][0], &locals[i][0][0], &out[i][0][0]);
+		}
+		else {
+			out[i] = locals[i];
+		}
+	}
+}
+
+// Four joints at a time: the quaternions transposed to x, y, z, w vectors,
+// the matrix columns built across joints and transposed back
+static void ComposeTRSSse2(const glm::vec3 *t, const glm::quat *r, const glm::vec3 *s, glm::mat4 *out, size_t count)
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 zero = _mm_setzero_ps();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 qx = _mm_loadu_ps(&r[i].x);
+		__m128 qy = _mm_loadu_ps(&r[i + 1].x);
+		__m128 qz = _mm_loadu_ps(&r[i + 2].x);
+		__m128 qw = _mm_loadu_ps(&r[i + 3].x);
+		_MM_TRANSPOSE4_PS(qx, qy, qz, qw);
+
+		__m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+		__m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+		__m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+		__m128 sx = _mm_setr_ps(s[i].x, s[i + 1].x, s[i + 2].x, s[i + 3].x);
+		__m128 sy = _mm_setr_ps(s[i].y, s[i + 1].y, s[i + 2].y, s[i + 3].y);
+		__m128 sz = _mm_setr_ps(s[i].z, s[i + 1].z, s[i + 2].z, s[i + 3].z);
+
+		// Same terms as glm::mat3_cast, columns scaled
+		__m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		__m128 c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		__m128 c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		__m128 c0w = zero;
+		__m128 c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		__m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		__m128 c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		__m128 c1w = zero;
+		__m128 c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		__m128 c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		__m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		__m128 c2w = zero;
+		__m128 c3x = _mm_setr_ps(t[i].x, t[i + 1].x, t[i + 2].x, t[i + 3].x);
+		__m128 c3y = _mm_setr_ps(t[i].y, t[i + 1].y, t[i + 2].y, t[i + 3].y);
+		__m128 c3z = _mm_setr_ps(t[i].z, t[i + 1].z, t[i + 2].z, t[i + 3].z);
+		__m128 c3w = one;
+		_MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+		_MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+		_MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+		_MM_TRANSPOSE4_PS(c3x, c3y, c3z, c3w);
+
+		float *m = &out[i][0][0];
+		_mm_storeu_ps(m, c0x);
+		_mm_storeu_ps(m + 4, c1x);
+		_mm_storeu_ps(m + 8, c2x);
+		_mm_storeu_ps(m + 12, c3x);
+		_mm_storeu_ps(m + 16, c0y);
+		_mm_storeu_ps(m + 20, c1y);
+		_mm_storeu_ps(m + 24, c2y);
+		_mm_storeu_ps(m + 28, c3y);
+		_mm_storeu_ps(m + 32, c0z);
+		_mm_storeu_ps(m + 36, c1z);
+		_mm_storeu_ps(m + 40, c2z);
+		_mm_storeu_ps(m + 44, c3z);
+		_mm_storeu_ps(m + 48, c0w);
+		_mm_storeu_ps(m + 52, c1w);
+		_mm_storeu_ps(m + 56, c2w);
+		_mm_storeu_ps(m + 60, c3w);
+	}
+	ComposeTRSGlm(t + i, r + i, s + i, out + i, count - i);
+}
+
+// Eberly, "A Fast and Accurate Algorithm for Computing SLERP": the slerp
+// weights as polynomials in t and cos(angle), no trigonometry or division
+static const float slerpU[8] = {
+	1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9),
+	1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), 1.85298109240830f / (8 * 17)
+};
+static const float slerpV[8] = {
+	1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9,
+	5.0f / 11, 6.0f / 13, 7.0f / 15, 1.85298109240830f * 8 / 17
+};
+
+// sin(t * angle) / sin(angle) for cosAngleMinusOne = cos(angle) - 1
+static inline __m128 SlerpWeightSse2(__m128 t, __m128 cosAngleMinusOne)
+{
+	__m128 tt = _mm_mul_ps(t, t);
+	__m128 weight = _mm_set1_ps(1.0f);
+	for (int k = 7; k >= 0; k--) {
+		__m128 b = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(slerpU[k]), tt), _mm_set1_ps(slerpV[k])), cosAngleMinusOne);
+		weight = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(b, weight));
+	}
+	return _mm_mul_ps(t, weight);
+}
+
+static void SlerpSse2(const glm::quat *a, const glm::quat *b, const float *weights, glm::quat *out, size_t count)
+{
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 ax = _mm_loadu_ps(&a[i].x), ay = _mm_loadu_ps(&a[i + 1].x);
+		__m128 az = _mm_loadu_ps(&a[i + 2].x), aw = _mm_loadu_ps(&a[i + 3].x);
+		__m128 bx = _mm_loadu_ps(&b[i].x), by = _mm_loadu_ps(&b[i + 1].x);
+		__m128 bz = _mm_loadu_ps(&b[i + 2].x), bw = _mm_loadu_ps(&b[i + 3].x);
+		_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+		_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+		// Negate b where the dot product is negative, for the shorter arc
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+			_mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		__m128 flip = _mm_and_ps(dot, signBit);
+		bx = _mm_xor_ps(bx, flip);
+		by = _mm_xor_ps(by, flip);
+		bz = _mm_xor_ps(bz, flip);
+		bw = _mm_xor_ps(bw, flip);
+		__m128 cosMinusOne = _mm_sub_ps(_mm_andnot_ps(signBit, dot), _mm_set1_ps(1.0f));
+
+		__m128 t = _mm_loadu_ps(weights + i);
+		__m128 weightB = SlerpWeightSse2(t, cosMinusOne);
+		__m128 weightA = SlerpWeightSse2(_mm_sub_ps(_mm_set1_ps(1.0f), t), cosMinusOne);
+
+		__m128 x = _mm_add_ps(_mm_mul_ps(ax, weightA), _mm_mul_ps(bx, weightB));
+		__m128 y = _mm_add_ps(_mm_mul_ps(ay, weightA), _mm_mul_ps(by, weightB));
+		__m128 z = _mm_add_ps(_mm_mul_ps(az, weightA), _mm_mul_ps(bz, weightB));
+		__m128 w = _mm_add_ps(_mm_mul_ps(aw, weightA), _mm_mul_ps(bw, weightB));
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(&out[i].x, x);
+		_mm_storeu_ps(&out[i + 1].x, y);
+		_mm_storeu_ps(&out[i + 2].x, z);
+		_mm_storeu_ps(&out[i + 3].x, w);
+	}
+	SlerpGlm(a + i, b + i, weights + i, out + i, count - i);
+}
+
+static const Mat4Kernels sse2Kernels = { "sse2", MultiplySse2Batch, PropagateSse2, ComposeTRSSse2, SlerpSse2 };
+
+// Defined in mat4_kernels_avx2.cpp, the only file built for AVX2. NULL when
+// that build did not target x86.
+const Mat4Kernels *Avx2Mat4Kernels(const Mat4Kernels &sse2);
+
+static bool CpuHasAvx2Fma()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool fma = (info[2] & (1 << 12)) != 0;
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	// The OS must save the AVX registers too
+	if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+#endif
+
+const Mat4Kernels *Mat4KernelSet(Mat4KernelLevel level)
+{
+	switch (level) {
+	case Mat4KernelsGlm:
+		return &glmKernels;
+#ifdef MAT4_KERNELS_SSE2
+	case Mat4KernelsSse2:
+		return &sse2Kernels;
+	case Mat4KernelsAvx2:
+		return CpuHasAvx2Fma() ? Avx2Mat4Kernels(sse2Kernels) : NULL;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+static const Mat4Kernels &SelectMat4Kernels()
+{
+	const Mat4Kernels *best = Mat4KernelSet(Mat4KernelsAvx2);
+	if (!best) {
+		best = Mat4KernelSet(Mat4KernelsSse2);
+	}
+	return best ? *best : glmKernels;
+}
+
+const Mat4Kernels &ActiveMat4Kernels()
+{
+	static const Mat4Kernels &active = SelectMat4Kernels();
+	return active;
+}
@@ -0,0 +1,42 @@
+#ifndef _MAT4_KERNELS_H_
+#define _MAT4_KERNELS_H_
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstddef>
+
+// Batched transform math for skeleton updates. The same operations come in
+// up to three sets: glm one element at a time (the reference), SSE2 and
+// AVX2 with FMA. ActiveMat4Kernels picks the best set the CPU supports the
+// first time it is called. Arrays need no particular alignment.
+enum Mat4KernelLevel {
+	Mat4KernelsGlm,
+	Mat4KernelsSse2,
+	Mat4KernelsAvx2
+};
+
+struct Mat4Kernels {
+	const char *name;
+
+	// out[i] = a[aIndex ? aIndex[i] : i] * b[i]. out may be b.
+	void (*multiply)(const glm::mat4 *a, const int *aIndex, const glm::mat4 *b, glm::mat4 *out, size_t count);
+
+	// out[i] = out[parents[i]] * locals[i], or locals[i] for parents[i] < 0.
+	// Parents must come before their children.
+	void (*propagate)(const int *parents, const glm::mat4 *locals, glm::mat4 *out, size_t count);
+
+	// out[i] = translate(t[i]) * mat4_cast(r[i]) * scale(s[i])
+	void (*composeTRS)(const glm::vec3 *t, const glm::quat *r, const glm::vec3 *s, glm::mat4 *out, size_t count);
+
+	// out[i] = slerp(a[i], b[i], weights[i]) along the shorter arc. The SIMD
+	// sets use Eberly's polynomial slerp: within 1e-6 of glm::slerp for
+	// rotations up to 120 degrees apart, 3e-5 at worst.
+	void (*slerp)(const glm::quat *a, const glm::quat *b, const float *weights, glm::quat *out, size_t count);
+};
+
+const Mat4Kernels &ActiveMat4Kernels();
+
+// A particular set, NULL when this build or CPU cannot run it
+const Mat4Kernels *Mat4KernelSet(Mat4KernelLevel level);
+
+#endif
@@ -0,0 +1,176 @@
+#include "mat4_kernels.h"
+
+// Built with AVX2 and FMA enabled (see CMakeLists.txt) and only called when
+// the CPU has them. Nothing here may use glm or other inline library code:
+// the linker could keep these AVX2 copies of shared inline functions for
+// the whole program. Matrices and quaternions are read as plain floats.
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+
+#include <immintrin.h>
+
+// The SSE2 set, for the elements left over after the 8-wide loops
+static const Mat4Kernels *sse2Kernels = NULL;
+
+// The same four floats in both 128-bit lanes
+static inline __m256 Duplicate(const float *p)
+{
+	__m128 v = _mm_loadu_ps(p);
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(v), v, 1);
+}
+
+// Two output columns per register: each lane weights the columns of a by
+// one column of b. out may be a or b, as in the SSE2 version.
+static inline void MultiplyAvx2(const float *a, const float *b, float *out)
+{
+	__m256 a0 = Duplicate(a);
+	__m256 a1 = Duplicate(a + 4);
+	__m256 a2 = Duplicate(a + 8);
+	__m256 a3 = Duplicate(a + 12);
+	__m256 b01 = _mm256_loadu_ps(b);
+	__m256 b23 = _mm256_loadu_ps(b + 8);
+
+	__m256 c01 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, 0x00));
+	c01 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b01, b01, 0x55), c01);
+	c01 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b01, b01, 0xAA), c01);
+	c01 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b01, b01, 0xFF), c01);
+
+	__m256 c23 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b23, b23, 0x00));
+	c23 = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(b23, b23, 0x55), c23);
+	c23 = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(b23, b23, 0xAA), c23);
+	c23 = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(b23, b23, 0xFF), c23);
+
+	_mm256_storeu_ps(out, c01);
+	_mm256_storeu_ps(out + 8, c23);
+}
+
+static void MultiplyAvx2Batch(const glm::mat4 *a, const int *aIndex, const glm::mat4 *b, glm::mat4 *out, size_t count)
+{
+	const float *af = reinterpret_cast<const float *>(a);
+	const float *bf = reinterpret_cast<const float *>(b);
+	float *outf = reinterpret_cast<float *>(out);
+	for (size_t i = 0; i < count; i++) {
+		MultiplyAvx2(af + 16 * (aIndex ? aIndex[i] : i), bf + 16 * i, outf + 16 * i);
+	}
+}
+
+static void PropagateAvx2(const int *parents, const glm::mat4 *locals, glm::mat4 *out, size_t count)
+{
+	const float *localf = reinterpret_cast<const float *>(locals);
+	float *outf = reinterpret_cast<float *>(out);
+	for (size_t i = 0; i < count; i++) {
+		if (parents[i] >= 0) {
+			MultiplyAvx2(outf + 16 * parents[i], localf + 16 * i, outf + 16 * i);
+		}
+		else {
+			_mm256_storeu_ps(outf + 16 * i, _mm256_loadu_ps(localf + 16 * i));
+			_mm256_storeu_ps(outf + 16 * i + 8, _mm256_loadu_ps(localf + 16 * i + 8));
+		}
+	}
+}
+
+// Transposes four 4-float rows within each 128-bit lane
+static inline void TransposeLanes(__m256 &r0, __m256 &r1, __m256 &r2, __m256 &r3)
+{
+	__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+	__m256 t1 = _mm256_unpacklo_ps(r2, r3);
+	__m256 t2 = _mm256_unpackhi_ps(r0, r1);
+	__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+	r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+	r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+	r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+// Quaternions i and i + 4 in the low and high lane
+static inline __m256 LoadPair(const float *q, size_t i)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(q + 4 * i)), _mm_loadu_ps(q + 4 * (i + 4)), 1);
+}
+
+static inline void StorePair(float *q, size_t i, __m256 v)
+{
+	_mm_storeu_ps(q + 4 * i, _mm256_castps256_ps128(v));
+	_mm_storeu_ps(q + 4 * (i + 4), _mm256_extractf128_ps(v, 1));
+}
+
+// Same coefficients as the SSE2 version, see there
+static const float slerpU[8] = {
+	1.0f / (1 * 3), 1.0f / (2 * 5), 1.0f / (3 * 7), 1.0f / (4 * 9),
+	1.0f / (5 * 11), 1.0f / (6 * 13), 1.0f / (7 * 15), 1.85298109240830f / (8 * 17)
+};
+static const float slerpV[8] = {
+	1.0f / 3, 2.0f / 5, 3.0f / 7, 4.0f / 9,
+	5.0f / 11, 6.0f / 13, 7.0f / 15, 1.85298109240830f * 8 / 17
+};
+
+static inline __m256 SlerpWeightAvx2(__m256 t, __m256 cosAngleMinusOne)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	__m256 tt = _mm256_mul_ps(t, t);
+	__m256 weight = one;
+	for (int k = 7; k >= 0; k--) {
+		__m256 b = _mm256_mul_ps(_mm256_fmsub_ps(_mm256_set1_ps(slerpU[k]), tt, _mm256_set1_ps(slerpV[k])), cosAngleMinusOne);
+		weight = _mm256_fmadd_ps(b, weight, one);
+	}
+	return _mm256_mul_ps(t, weight);
+}
+
+static void SlerpAvx2(const glm::quat *a, const glm::quat *b, const float *weights, glm::quat *out, size_t count)
+{
+	const float *af = reinterpret_cast<const float *>(a);
+	const float *bf = reinterpret_cast<const float *>(b);
+	float *outf = reinterpret_cast<float *>(out);
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 ax = LoadPair(af, i), ay = LoadPair(af, i + 1), az = LoadPair(af, i + 2), aw = LoadPair(af, i + 3);
+		__m256 bx = LoadPair(bf, i), by = LoadPair(bf, i + 1), bz = LoadPair(bf, i + 2), bw = LoadPair(bf, i + 3);
+		TransposeLanes(ax, ay, az, aw);
+		TransposeLanes(bx, by, bz, bw);
+
+		__m256 dot = _mm256_fmadd_ps(ax, bx, _mm256_fmadd_ps(ay, by, _mm256_fmadd_ps(az, bz, _mm256_mul_ps(aw, bw))));
+		__m256 flip = _mm256_and_ps(dot, signBit);
+		bx = _mm256_xor_ps(bx, flip);
+		by = _mm256_xor_ps(by, flip);
+		bz = _mm256_xor_ps(bz, flip);
+		bw = _mm256_xor_ps(bw, flip);
+		__m256 cosMinusOne = _mm256_sub_ps(_mm256_andnot_ps(signBit, dot), one);
+
+		// Weights i..i+3 land in the low lane and i+4..i+7 in the high one,
+		// matching the quaternion pairs
+		__m256 t = _mm256_loadu_ps(weights + i);
+		__m256 weightB = SlerpWeightAvx2(t, cosMinusOne);
+		__m256 weightA = SlerpWeightAvx2(_mm256_sub_ps(one, t), cosMinusOne);
+
+		__m256 x = _mm256_fmadd_ps(ax, weightA, _mm256_mul_ps(bx, weightB));
+		__m256 y = _mm256_fmadd_ps(ay, weightA, _mm256_mul_ps(by, weightB));
+		__m256 z = _mm256_fmadd_ps(az, weightA, _mm256_mul_ps(bz, weightB));
+		__m256 w = _mm256_fmadd_ps(aw, weightA, _mm256_mul_ps(bw, weightB));
+		TransposeLanes(x, y, z, w);
+		StorePair(outf, i, x);
+		StorePair(outf, i + 1, y);
+		StorePair(outf, i + 2, z);
+		StorePair(outf, i + 3, w);
+	}
+	sse2Kernels->slerp(a + i, b + i, weights + i, out + i, count - i);
+}
+
+// TRS composition is bound by gathering the inputs, so it keeps the SSE2 kernel
+const Mat4Kernels *Avx2Mat4Kernels(const Mat4Kernels &sse2)
+{
+	static Mat4Kernels avx2Kernels = { "avx2", MultiplyAvx2Batch, PropagateAvx2, NULL, SlerpAvx2 };
+	sse2Kernels = &sse2;
+	avx2Kernels.composeTRS = sse2.composeTRS;
+	return &avx2Kernels;
+}
+
+#else
+
+const Mat4Kernels *Avx2Mat4Kernels(const Mat4Kernels &)
+{
+	return NULL;
+}
+
+#endif
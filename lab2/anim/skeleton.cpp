@@ -0,0 +1,104 @@
+#include "skeleton.h"
+#include "mat4_kernels.h"
+
+#include <tiny_gltf.h>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+// Orders joints by depth below their root, which puts parents first
+struct JointDepthLess {
+	const std::vector<int> *depths;
+
+	bool operator()(int a, int b) const
+	{
+		return (*depths)[a] < (*depths)[b];
+	}
+};
+
+void CompileSkeleton(const tinygltf::Model &model, const tinygltf::Skin &skin, Skeleton &skeleton)
+{
+	skeleton = Skeleton();
+	size_t skinJointCount = skin.joints.size();
+
+	// Parent of every node, from the children lists
+	std::vector<int> nodeParents(model.nodes.size(), -1);
+	for (size_t i = 0; i < model.nodes.size(); i++) {
+		const std::vector<int> &children = model.nodes[i].children;
+		for (size_t c = 0; c < children.size(); c++) {
+			nodeParents[children[c]] = (int)i;
+		}
+	}
+
+	// Position of each node in skin.joints, so only joints count as parents
+	std::vector<int> skinIndex(model.nodes.size(), -1);
+	for (size_t k = 0; k < skinJointCount; k++) {
+		skinIndex[skin.joints[k]] = (int)k;
+	}
+
+	// Depth counts joint ancestors only; nodes between joints are skipped
+	std::vector<int> depths(skinJointCount, 0);
+	std::vector<int> order(skinJointCount);
+	for (size_t k = 0; k < skinJointCount; k++) {
+		for (int node = nodeParents[skin.joints[k]]; node >= 0; node = nodeParents[node]) {
+			depths[k] += skinIndex[node] >= 0;
+		}
+		order[k] = (int)k;
+	}
+	JointDepthLess shallower;
+	shallower.depths = &depths;
+	std::stable_sort(order.begin(), order.end(), shallower);
+
+	skeleton.jointNodes.resize(skinJointCount);
+	skeleton.parentIndex.resize(skinJointCount, -1);
+	skeleton.nodeJoints.assign(model.nodes.size(), -1);
+	skeleton.skinJoints.resize(skinJointCount);
+	for (size_t j = 0; j < skinJointCount; j++) {
+		skeleton.jointNodes[j] = skin.joints[order[j]];
+		skeleton.nodeJoints[skeleton.jointNodes[j]] = (int)j;
+		skeleton.skinJoints[order[j]] = (int)j;
+	}
+	for (size_t j = 0; j < skinJointCount; j++) {
+		int node = nodeParents[skeleton.jointNodes[j]];
+		while (node >= 0 && skeleton.nodeJoints[node] < 0) {
+			node = nodeParents[node];
+		}
+		skeleton.parentIndex[j] = node >= 0 ? skeleton.nodeJoints[node] : -1;
+	}
+
+	// Identity when the skin has none
+	skeleton.inverseBindMatrices.assign(skinJointCount, glm::mat4(1.0f));
+	if (skin.inverseBindMatrices >= 0) {
+		const tinygltf::Accessor &accessor = model.accessors[skin.inverseBindMatrices];
+		const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
+		const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
+		const unsigned char *data = &buffer.data[bufferView.byteOffset + accessor.byteOffset];
+		int stride = accessor.ByteStride(bufferView);
+		for (size_t k = 0; k < skinJointCount && k < accessor.count; k++) {
+			float m[16];
+			memcpy(m, data + k * stride, sizeof(m));
+			skeleton.inverseBindMatrices[k] = glm::make_mat4(m);
+		}
+	}
+
+	RestJointPoses(model, skeleton.jointNodes, skeleton.restPoses);
+}
+
+void ComposeLocalTransforms(const JointPoses &poses, glm::mat4 *locals)
+{
+	ActiveMat4Kernels().composeTRS(poses.translations.data(), poses.rotations.data(), poses.scales.data(), locals,
+		poses.translations.size());
+}
+
+void ComputeGlobalTransforms(const Skeleton &skeleton, const glm::mat4 *locals, glm::mat4 *globals)
+{
+	ActiveMat4Kernels().propagate(skeleton.parentIndex.data(), locals, globals, skeleton.jointCount());
+}
+
+void ComputeJointMatrices(const Skeleton &skeleton, const glm::mat4 *globals, glm::mat4 *jointMatrices)
+{
+	ActiveMat4Kernels().multiply(globals, skeleton.skinJoints.data(), skeleton.inverseBindMatrices.data(),
+		jointMatrices, skeleton.skinJoints.size());
+}
@@ -0,0 +1,41 @@
+#ifndef _SKELETON_H_
+#define _SKELETON_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "animation.h"
+
+namespace tinygltf {
+class Model;
+struct Skin;
+}
+
+// The joints of a skin compiled for evaluation without the glTF node tree.
+// Joints are sorted so that every parent comes before its children, so the
+// hierarchy is one forward pass over parentIndex. Joint indices below are
+// in this order, not the skin's; skinJoints maps back for the shader.
+struct Skeleton {
+	std::vector<int> jointNodes;		// Node of each joint
+	std::vector<int> parentIndex;		// Joint index of the parent, -1 for a root
+	std::vector<int> nodeJoints;		// Joint index of each node, -1 if not a joint
+	std::vector<int> skinJoints;		// Joint index of each entry of skin.joints
+	std::vector<glm::mat4> inverseBindMatrices;	// In skin.joints order
+	JointPoses restPoses;
+
+	size_t jointCount() const { return jointNodes.size(); }
+};
+
+void CompileSkeleton(const tinygltf::Model &model, const tinygltf::Skin &skin, Skeleton &skeleton);
+
+// Local matrices (translate * rotate * scale) of every joint
+void ComposeLocalTransforms(const JointPoses &poses, glm::mat4 *locals);
+
+// Parent global times local, in joint order. Roots take their local
+// transform as is.
+void ComputeGlobalTransforms(const Skeleton &skeleton, const glm::mat4 *locals, glm::mat4 *globals);
+
+// Global times inverse bind matrix, in skin.joints order as u_jointMat expects
+void ComputeJointMatrices(const Skeleton &skeleton, const glm::mat4 *globals, glm::mat4 *jointMatrices);
+
+#endif
@@ -0,0 +1,153 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : data(NULL), size(0)
+#ifdef _WIN32
+	, fileHandle(INVALID_HANDLE_VALUE), mappingHandle(NULL)
+#else
+	, fd(-1)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) : data(NULL), size(0)
+#ifdef _WIN32
+	, fileHandle(INVALID_HANDLE_VALUE), mappingHandle(NULL)
+#else
+	, fd(-1)
+#endif
+{
+	swap(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other)
+{
+	if (this != &other) {
+		close();
+		swap(other);
+	}
+	return *this;
+}
+
+void MappedFile::swap(MappedFile &other)
+{
+	std::swap(data, other.data);
+	std::swap(size, other.size);
+#ifdef _WIN32
+	std::swap(fileHandle, other.fileHandle);
+	std::swap(mappingHandle, other.mappingHandle);
+#else
+	std::swap(fd, other.fd);
+#endif
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char *path)
+{
+	close();
+	fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize)) {
+		close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+	if (size == 0) {
+		return true;
+	}
+
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mappingHandle) {
+		close();
+		return false;
+	}
+	data = (const char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+	if (mappingHandle) {
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != INVALID_HANDLE_VALUE) {
+		CloseHandle(fileHandle);
+	}
+	data = NULL;
+	size = 0;
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const char *path)
+{
+	close();
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close();
+		return false;
+	}
+	size = (size_t)st.st_size;
+	if (size == 0) {
+		return true;
+	}
+
+	void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (mapping == MAP_FAILED) {
+		close();
+		return false;
+	}
+	madvise(mapping, size, MADV_SEQUENTIAL);
+	data = (const char *)mapping;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data) {
+		munmap((void *)data, size);
+	}
+	if (fd >= 0) {
+		::close(fd);
+	}
+	data = NULL;
+	size = 0;
+	fd = -1;
+}
+
+#endif
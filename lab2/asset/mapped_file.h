@@ -0,0 +1,34 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Moving it keeps the mapping, so
+// pointers into data stay valid.
+struct MappedFile {
+	const char *data;
+	size_t size;
+
+#ifdef _WIN32
+	void *fileHandle;
+	void *mappingHandle;
+#else
+	int fd;
+#endif
+
+	MappedFile();
+	~MappedFile();
+	MappedFile(MappedFile &&other);
+	MappedFile &operator=(MappedFile &&other);
+
+	bool open(const char *path);
+	void close();
+
+private:
+	void swap(MappedFile &other);
+
+	MappedFile(const MappedFile &);
+	MappedFile &operator=(const MappedFile &);
+};
+
+#endif
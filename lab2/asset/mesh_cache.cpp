@@ -0,0 +1,207 @@
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+
+#include <profile/profiler.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+static const unsigned int meshCacheVersion = 4;
+
+static std::string MeshCachePath(const char *sourcePath)
+{
+	return std::string(sourcePath) + ".meshbin";
+}
+
+static bool StatSource(const char *sourcePath, unsigned long long &size, long long &mtime)
+{
+	struct stat st;
+	if (stat(sourcePath, &st) != 0) {
+		return false;
+	}
+	size = (unsigned long long)st.st_size;
+	mtime = (long long)st.st_mtime;
+	return true;
+}
+
+static void ComputeBounds(const ObjMesh &mesh, float boundsMin[3], float boundsMax[3])
+{
+	for (int axis = 0; axis < 3; axis++) {
+		boundsMin[axis] = boundsMax[axis] = mesh.vertices.empty() ? 0.0f : mesh.vertices[axis];
+	}
+	for (size_t i = 3; i < mesh.vertices.size(); i += 3) {
+		for (int axis = 0; axis < 3; axis++) {
+			boundsMin[axis] = std::min(boundsMin[axis], mesh.vertices[i + axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], mesh.vertices[i + axis]);
+		}
+	}
+}
+
+static unsigned long long AlignBlock(unsigned long long offset)
+{
+	return (offset + 15) & ~15ULL;
+}
+
+bool ReadMeshCache(const char *sourcePath, MappedMesh &mesh)
+{
+	unsigned long long sourceSize;
+	long long sourceMtime;
+	if (!StatSource(sourcePath, sourceSize, sourceMtime)) {
+		return false;
+	}
+	if (!mesh.file.open(MeshCachePath(sourcePath).c_str())) {
+		return false;
+	}
+
+	const char *data = mesh.file.data;
+	size_t size = mesh.file.size;
+	if (size < sizeof(MeshCacheHeader)) {
+		mesh.file.close();
+		return false;
+	}
+
+	const MeshCacheHeader *header = (const MeshCacheHeader *)data;
+	bool valid = memcmp(header->magic, "MESH", 4) == 0 &&
+		header->version == meshCacheVersion &&
+		header->sourceSize == sourceSize &&
+		header->sourceMtime == sourceMtime &&
+		(header->vertexStride == 5 || header->vertexStride == 8) &&
+		header->vertexOffset + header->vertexCount * 1ULL * header->vertexStride * sizeof(GLfloat) <= size &&
+		header->indexOffset + header->indexCount * 1ULL * sizeof(GLuint) <= size;
+	if (!valid) {
+		mesh.file.close();
+		return false;
+	}
+
+	mesh.header = header;
+	mesh.vertexData = (const GLfloat *)(data + header->vertexOffset);
+	mesh.indices = (const GLuint *)(data + header->indexOffset);
+	return true;
+}
+
+static void WriteBlock(FILE *file, unsigned long long offset, const void *data, size_t bytes)
+{
+	static const char padding[16] = { 0 };
+	long position = ftell(file);
+	if (position >= 0 && (unsigned long long)position < offset) {
+		fwrite(padding, 1, (size_t)(offset - position), file);
+	}
+	if (bytes > 0) {
+		fwrite(data, 1, bytes, file);
+	}
+}
+
+void InterleaveMeshVertices(const ObjMesh &mesh, std::vector<GLfloat> &vertexData)
+{
+	bool hasNormals = !mesh.normals.empty();
+	size_t stride = MeshVertexStride(hasNormals);
+	size_t vertexCount = mesh.vertices.size() / 3;
+	vertexData.resize(vertexCount * stride);
+	for (size_t i = 0; i < vertexCount; i++) {
+		GLfloat *vertex = &vertexData[i * stride];
+		vertex[0] = mesh.vertices[i * 3];
+		vertex[1] = mesh.vertices[i * 3 + 1];
+		vertex[2] = mesh.vertices[i * 3 + 2];
+		vertex[3] = mesh.uvs[i * 2];
+		vertex[4] = mesh.uvs[i * 2 + 1];
+		if (hasNormals) {
+			vertex[5] = mesh.normals[i * 3];
+			vertex[6] = mesh.normals[i * 3 + 1];
+			vertex[7] = mesh.normals[i * 3 + 2];
+		}
+	}
+}
+
+bool WriteMeshCache(const char *sourcePath, const ObjMesh &mesh)
+{
+	MeshCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "MESH", 4);
+	header.version = meshCacheVersion;
+	if (!StatSource(sourcePath, header.sourceSize, header.sourceMtime)) {
+		return false;
+	}
+
+	bool hasNormals = !mesh.normals.empty();
+	header.vertexCount = (unsigned int)(mesh.vertices.size() / 3);
+	header.indexCount = (unsigned int)mesh.indices.size();
+	header.vertexStride = MeshVertexStride(hasNormals);
+	header.vertexOffset = AlignBlock(sizeof(MeshCacheHeader));
+	header.indexOffset = AlignBlock(header.vertexOffset + header.vertexCount * 1ULL * header.vertexStride * sizeof(GLfloat));
+	ComputeBounds(mesh, header.boundsMin, header.boundsMax);
+
+	std::vector<GLfloat> interleaved;
+	InterleaveMeshVertices(mesh, interleaved);
+
+	// Tile workers may write the same cache concurrently: write a private
+	// temporary file and rename it into place
+	std::ostringstream tempPath;
+	tempPath << MeshCachePath(sourcePath) << ".tmp" << std::this_thread::get_id();
+	FILE *file = fopen(tempPath.str().c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	fwrite(&header, sizeof(header), 1, file);
+	WriteBlock(file, header.vertexOffset, interleaved.data(), interleaved.size() * sizeof(GLfloat));
+	WriteBlock(file, header.indexOffset, mesh.indices.data(), header.indexCount * sizeof(GLuint));
+	bool ok = ferror(file) == 0;
+	ok = fclose(file) == 0 && ok;
+
+	std::string cachePath = MeshCachePath(sourcePath);
+	if (ok && std::rename(tempPath.str().c_str(), cachePath.c_str()) != 0) {
+		// Windows does not replace an existing file on rename
+		std::remove(cachePath.c_str());
+		ok = std::rename(tempPath.str().c_str(), cachePath.c_str()) == 0;
+	}
+	if (!ok) {
+		std::remove(tempPath.str().c_str());
+	}
+	return ok;
+}
+
+bool LoadMesh(const char *sourcePath, MeshData &mesh)
+{
+	PROFILE_SCOPE("LoadMesh");
+	mesh = MeshData();
+	if (ReadMeshCache(sourcePath, mesh.mapped)) {
+		const MeshCacheHeader &header = *mesh.mapped.header;
+		mesh.vertexData = mesh.mapped.vertexData;
+		mesh.indices = mesh.mapped.indices;
+		mesh.vertexCount = header.vertexCount;
+		mesh.indexCount = header.indexCount;
+		mesh.vertexStride = header.vertexStride;
+		memcpy(mesh.boundsMin, header.boundsMin, sizeof(mesh.boundsMin));
+		memcpy(mesh.boundsMax, header.boundsMax, sizeof(mesh.boundsMax));
+
+		// Fault the pages in here on the loading thread, so the upload on the
+		// render thread reads memory instead of the disk
+		const volatile char *bytes = mesh.mapped.file.data;
+		for (size_t offset = 0; offset < mesh.mapped.file.size; offset += 4096) {
+			(void)bytes[offset];
+		}
+		return true;
+	}
+
+	ObjMesh parsed;
+	if (!LoadOBJ(sourcePath, parsed)) {
+		return false;
+	}
+	OptimizeMesh(parsed, sourcePath);
+	WriteMeshCache(sourcePath, parsed);
+
+	InterleaveMeshVertices(parsed, mesh.vertexStorage);
+	mesh.indexStorage.swap(parsed.indices);
+	mesh.vertexData = mesh.vertexStorage.data();
+	mesh.indices = mesh.indexStorage.data();
+	mesh.vertexCount = (unsigned int)(parsed.vertices.size() / 3);
+	mesh.indexCount = (unsigned int)mesh.indexStorage.size();
+	mesh.vertexStride = MeshVertexStride(!parsed.normals.empty());
+	ComputeBounds(parsed, mesh.boundsMin, mesh.boundsMax);
+	return true;
+}
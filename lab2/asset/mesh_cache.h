@@ -0,0 +1,84 @@
+#ifndef _MESH_CACHE_H_
+#define _MESH_CACHE_H_
+
+#include "mapped_file.h"
+#include "obj_loader.h"
+
+#include <vector>
+
+// Binary copy of a parsed and optimised OBJ, written next to the source as
+// <source>.meshbin after the first parse. It stays valid while the source
+// size and modification time match the ones recorded in the header.
+//
+// Layout: MeshCacheHeader, then the vertex block and the index block, each
+// starting at a 16-byte aligned offset recorded in the header. The vertex
+// block is the vertex buffer the mesh registry binds as is: position and uv
+// per vertex, followed by the normal when the source has normals. Vertex
+// colors depend on the user of the mesh, so they are not stored here.
+struct MeshCacheHeader {
+	char magic[4];				// "MESH"
+	unsigned int version;
+	unsigned long long sourceSize;
+	long long sourceMtime;
+
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int vertexStride;	// Floats per vertex: 5 (position, uv) or 8 (with normal)
+	unsigned int reserved;
+	unsigned long long vertexOffset;
+	unsigned long long indexOffset;
+	float boundsMin[3];			// Object space bounds of the positions
+	float boundsMax[3];
+};
+
+// A cache file mapped into memory; the blocks are in the layout
+// MeshVertexStride and InterleaveMeshVertices describe
+struct MappedMesh {
+	MappedFile file;
+	const MeshCacheHeader *header;
+	const GLfloat *vertexData;	// header->vertexStride floats per vertex
+	const GLuint *indices;
+
+	MappedMesh() : header(NULL), vertexData(NULL), indices(NULL) {}
+};
+
+// Floats per vertex in the vertex block: position (3), uv (2), normal (3)
+inline unsigned int MeshVertexStride(bool hasNormals)
+{
+	return hasNormals ? 8 : 5;
+}
+
+// Writes the vertices of mesh in the vertex block layout
+void InterleaveMeshVertices(const ObjMesh &mesh, std::vector<GLfloat> &vertexData);
+
+// Vertex and index blocks in the cache layout, ready for glBufferData. After
+// a cache hit they point into the mapped file; after a miss they point into
+// the owned vectors filled from the parsed OBJ. Empty until loaded; movable
+// but not copyable.
+struct MeshData {
+	MappedMesh mapped;
+	std::vector<GLfloat> vertexStorage;
+	std::vector<GLuint> indexStorage;
+
+	const GLfloat *vertexData;
+	const GLuint *indices;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int vertexStride;
+	float boundsMin[3];
+	float boundsMax[3];
+
+	MeshData() : vertexData(NULL), indices(NULL), vertexCount(0), indexCount(0), vertexStride(0) {}
+	bool empty() const { return indexCount == 0; }
+};
+
+// Maps <sourcePath>.meshbin, false when it is missing, stale or malformed
+bool ReadMeshCache(const char *sourcePath, MappedMesh &mesh);
+
+bool WriteMeshCache(const char *sourcePath, const ObjMesh &mesh);
+
+// Maps the binary cache when it is current, otherwise parses the OBJ and
+// writes the cache for the next run
+bool LoadMesh(const char *sourcePath, MeshData &mesh);
+
+#endif
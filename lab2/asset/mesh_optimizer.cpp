@@ -0,0 +1,293 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+
+// FIFO cache simulated with timestamps: a vertex is resident while fewer than
+// cacheSize misses happened since it was loaded
+struct VertexCacheSim {
+	std::vector<unsigned int> loadedAt;
+	unsigned int time;
+	unsigned int cacheSize;
+
+	VertexCacheSim(size_t vertexCount, unsigned int size)
+		: loadedAt(vertexCount, 0), time(size + 1), cacheSize(size) {}
+
+	void reset() { time += cacheSize + 1; }
+
+	bool resident(GLuint v) const { return time - loadedAt[v] <= cacheSize; }
+
+	// Returns the number of misses (0 or 1)
+	unsigned int touch(GLuint v)
+	{
+		if (resident(v)) {
+			return 0;
+		}
+		loadedAt[v] = time++;
+		return 1;
+	}
+};
+
+float ComputeACMR(const GLuint *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	if (indexCount < 3) {
+		return 0.0f;
+	}
+	VertexCacheSim cache(vertexCount, cacheSize);
+	size_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++) {
+		misses += cache.touch(indices[i]);
+	}
+	return (float)misses / (float)(indexCount / 3);
+}
+
+void OptimizeVertexCache(std::vector<GLuint> &indices, size_t vertexCount, std::vector<size_t> *clusters)
+{
+	size_t triangleCount = indices.size() / 3;
+	if (clusters) {
+		clusters->clear();
+	}
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Vertex -> triangle adjacency in CSR form; live counts the triangles
+	// of each vertex still waiting to be emitted
+	std::vector<unsigned int> live(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		live[indices[i]]++;
+	}
+	std::vector<size_t> adjacencyStart(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyStart[v + 1] = adjacencyStart[v] + live[v];
+	}
+	std::vector<unsigned int> adjacency(adjacencyStart[vertexCount]);
+	std::vector<size_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (int c = 0; c < 3; c++) {
+			adjacency[fill[indices[t * 3 + c]]++] = (unsigned int)t;
+		}
+	}
+
+	std::vector<GLuint> output;
+	output.reserve(triangleCount * 3);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<GLuint> deadEnd;
+	std::vector<GLuint> candidates;
+	VertexCacheSim cache(vertexCount, vertexCacheSize);
+	const long cacheSize = vertexCacheSize;
+
+	long fan = 0;
+	size_t cursor = 1;
+	bool restarted = true;
+	while (fan >= 0) {
+		if (restarted && clusters) {
+			clusters->push_back(output.size());
+		}
+
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (size_t a = adjacencyStart[fan]; a < adjacencyStart[fan + 1]; a++) {
+			unsigned int t = adjacency[a];
+			if (emitted[t]) {
+				continue;
+			}
+			emitted[t] = true;
+			for (int c = 0; c < 3; c++) {
+				GLuint v = indices[t * 3 + c];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				cache.touch(v);
+			}
+		}
+
+		// Prefer the candidate that stays resident longest while its
+		// remaining triangles are emitted
+		long best = -1;
+		long bestPriority = -1;
+		for (size_t i = 0; i < candidates.size(); i++) {
+			GLuint v = candidates[i];
+			if (live[v] == 0) {
+				continue;
+			}
+			long age = (long)(cache.time - cache.loadedAt[v]);
+			long priority = age + 2 * (long)live[v] <= cacheSize ? age : 0;
+			if (priority > bestPriority) {
+				best = v;
+				bestPriority = priority;
+			}
+		}
+
+		restarted = best < 0;
+		if (best < 0) {
+			// Dead end: fall back to recently used vertices, then to the
+			// next vertex in input order
+			while (!deadEnd.empty() && best < 0) {
+				GLuint v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0) {
+					best = v;
+				}
+			}
+			while (best < 0 && cursor < vertexCount) {
+				if (live[cursor] > 0) {
+					best = (long)cursor;
+				}
+				cursor++;
+			}
+		}
+		fan = best;
+	}
+
+	indices.swap(output);
+}
+
+struct OverdrawCluster {
+	size_t begin, end;
+	float sortKey;
+};
+
+static bool ClusterFrontFirst(const OverdrawCluster &a, const OverdrawCluster &b)
+{
+	return a.sortKey > b.sortKey;
+}
+
+void OptimizeOverdraw(std::vector<GLuint> &indices, const std::vector<GLfloat> &vertices,
+	const std::vector<size_t> &clusters, float threshold)
+{
+	size_t indexCount = indices.size() - indices.size() % 3;
+	size_t vertexCount = vertices.size() / 3;
+	if (clusters.empty() || indexCount == 0) {
+		return;
+	}
+
+	// Split hard clusters wherever a fresh cache start is cheap enough
+	std::vector<size_t> boundaries;
+	VertexCacheSim cache(vertexCount, vertexCacheSize);
+	for (size_t c = 0; c < clusters.size(); c++) {
+		size_t begin = clusters[c];
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : indexCount;
+		float clusterAcmr = ComputeACMR(&indices[begin], end - begin, vertexCount);
+
+		boundaries.push_back(begin);
+		cache.reset();
+		size_t misses = 0;
+		size_t start = begin;
+		for (size_t i = begin; i < end; i += 3) {
+			misses += cache.touch(indices[i]) + cache.touch(indices[i + 1]) + cache.touch(indices[i + 2]);
+			size_t triangles = (i + 3 - start) / 3;
+			if (i + 3 < end && (float)misses <= threshold * clusterAcmr * (float)triangles) {
+				boundaries.push_back(i + 3);
+				cache.reset();
+				misses = 0;
+				start = i + 3;
+			}
+		}
+	}
+
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	for (size_t v = 0; v < vertexCount; v++) {
+		for (int k = 0; k < 3; k++) {
+			meshCentroid[k] += vertices[v * 3 + k];
+		}
+	}
+	for (int k = 0; k < 3; k++) {
+		meshCentroid[k] /= (float)(vertexCount > 0 ? vertexCount : 1);
+	}
+
+	// Key: how far the cluster sits along its own normal from the mesh
+	// centre. Outer, outward facing clusters occlude the rest.
+	std::vector<OverdrawCluster> sorted(boundaries.size());
+	for (size_t c = 0; c < boundaries.size(); c++) {
+		OverdrawCluster &cluster = sorted[c];
+		cluster.begin = boundaries[c];
+		cluster.end = c + 1 < boundaries.size() ? boundaries[c + 1] : indexCount;
+
+		float centroid[3] = { 0.0f, 0.0f, 0.0f };
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+		for (size_t i = cluster.begin; i < cluster.end; i += 3) {
+			const GLfloat *p0 = &vertices[indices[i] * 3];
+			const GLfloat *p1 = &vertices[indices[i + 1] * 3];
+			const GLfloat *p2 = &vertices[indices[i + 2] * 3];
+			float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float weight = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int k = 0; k < 3; k++) {
+				centroid[k] += (p0[k] + p1[k] + p2[k]) * weight / 3.0f;
+				normal[k] += n[k];
+			}
+			area += weight;
+		}
+
+		cluster.sortKey = 0.0f;
+		float normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (area > 0.0f && normalLength > 0.0f) {
+			for (int k = 0; k < 3; k++) {
+				cluster.sortKey += (centroid[k] / area - meshCentroid[k]) * normal[k] / normalLength;
+			}
+		}
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), ClusterFrontFirst);
+
+	std::vector<GLuint> output;
+	output.reserve(indices.size());
+	for (size_t c = 0; c < sorted.size(); c++) {
+		output.insert(output.end(), indices.begin() + sorted[c].begin, indices.begin() + sorted[c].end);
+	}
+	indices.swap(output);
+}
+
+void OptimizeVertexFetch(ObjMesh &mesh)
+{
+	size_t vertexCount = mesh.vertices.size() / 3;
+	bool hasNormals = !mesh.normals.empty();
+	std::vector<GLuint> remap(vertexCount, 0xFFFFFFFFu);
+
+	ObjMesh reordered;
+	reordered.vertices.reserve(mesh.vertices.size());
+	reordered.uvs.reserve(mesh.uvs.size());
+	reordered.normals.reserve(mesh.normals.size());
+	reordered.indices.resize(mesh.indices.size());
+
+	GLuint next = 0;
+	for (size_t i = 0; i < mesh.indices.size(); i++) {
+		GLuint v = mesh.indices[i];
+		if (remap[v] == 0xFFFFFFFFu) {
+			remap[v] = next++;
+			reordered.vertices.insert(reordered.vertices.end(), &mesh.vertices[v * 3], &mesh.vertices[v * 3] + 3);
+			reordered.uvs.insert(reordered.uvs.end(), &mesh.uvs[v * 2], &mesh.uvs[v * 2] + 2);
+			if (hasNormals) {
+				reordered.normals.insert(reordered.normals.end(), &mesh.normals[v * 3], &mesh.normals[v * 3] + 3);
+			}
+		}
+		reordered.indices[i] = remap[v];
+	}
+
+	mesh.vertices.swap(reordered.vertices);
+	mesh.uvs.swap(reordered.uvs);
+	mesh.normals.swap(reordered.normals);
+	mesh.indices.swap(reordered.indices);
+}
+
+void OptimizeMesh(ObjMesh &mesh, const char *name)
+{
+	size_t vertexCount = mesh.vertices.size() / 3;
+	float before = ComputeACMR(mesh.indices.data(), mesh.indices.size(), vertexCount);
+
+	std::vector<size_t> clusters;
+	OptimizeVertexCache(mesh.indices, vertexCount, &clusters);
+	float cacheOnly = ComputeACMR(mesh.indices.data(), mesh.indices.size(), vertexCount);
+	OptimizeOverdraw(mesh.indices, mesh.vertices, clusters);
+	OptimizeVertexFetch(mesh);
+	float after = ComputeACMR(mesh.indices.data(), mesh.indices.size(), mesh.vertices.size() / 3);
+
+	std::cout << "Optimized " << name << ": ACMR " << std::fixed << std::setprecision(3)
+		<< before << " -> " << after << " (" << cacheOnly << " before overdraw pass)" << std::endl;
+	std::cout.unsetf(std::ios::fixed);
+}
@@ -0,0 +1,33 @@
+#ifndef _MESH_OPTIMIZER_H_
+#define _MESH_OPTIMIZER_H_
+
+#include "obj_loader.h"
+
+// Entries in the simulated post-transform cache. 16 is a conservative size
+// for FIFO-style caches on current hardware.
+const unsigned int vertexCacheSize = 16;
+
+// Average cache miss ratio: transformed vertices per triangle for a FIFO cache
+// of cacheSize entries. 3.0 is the worst case, 0.5 the limit for a large grid.
+float ComputeACMR(const GLuint *indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = vertexCacheSize);
+
+// Reorders triangles for post-transform cache locality (Tipsify, Sander et
+// al. 2007). When clusters is given it receives the index offset of every
+// point where the fan had to restart, for use by OptimizeOverdraw.
+void OptimizeVertexCache(std::vector<GLuint> &indices, size_t vertexCount, std::vector<size_t> *clusters = NULL);
+
+// Reorders the clusters of a cache-optimised index buffer so that outward
+// facing ones are drawn first. Clusters are split further while that costs
+// at most threshold times their ACMR, so 1.05 trades up to 5% cache hits for
+// less overdraw.
+void OptimizeOverdraw(std::vector<GLuint> &indices, const std::vector<GLfloat> &vertices,
+	const std::vector<size_t> &clusters, float threshold = 1.05f);
+
+// Renumbers vertices in order of first use so vertex fetch walks the buffers
+// linearly; unreferenced vertices are dropped.
+void OptimizeVertexFetch(ObjMesh &mesh);
+
+// Runs the three passes above and prints the ACMR before and after
+void OptimizeMesh(ObjMesh &mesh, const char *name);
+
+#endif
@@ -0,0 +1,555 @@
+#include "obj_loader.h"
+#include "mapped_file.h"
+
+#include <profile/profiler.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+static const double powersOf10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool IsBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline const char* SkipBlanks(const char* p, const char* end)
+{
+	while (p < end && IsBlank(*p)) ++p;
+	return p;
+}
+
+static inline const char* NextLine(const char* p, const char* end)
+{
+	const char* newline = (const char*)memchr(p, '\n', end - p);
+	return newline ? newline + 1 : end;
+}
+
+// from_chars-style float parser: returns the end of the number, or p when
+// there is none. Short decimals (all OBJ exports) take the exact fast path.
+static const char* ParseFloat(const char* p, const char* end, float& value)
+{
+	const char* start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+
+	unsigned long long mantissa = 0;
+	int significant = 0;
+	int exponent = 0;
+	bool anyDigit = false;
+	for (; p < end && IsDigit(*p); ++p) {
+		anyDigit = true;
+		if (significant < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			significant += mantissa != 0;
+		}
+		else {
+			exponent++;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (++p; p < end && IsDigit(*p); ++p) {
+			anyDigit = true;
+			if (significant < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				significant += mantissa != 0;
+				exponent--;
+			}
+		}
+	}
+	if (!anyDigit) {
+		return start;
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char* e = p + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+')) {
+			negativeExponent = *e == '-';
+			++e;
+		}
+		if (e < end && IsDigit(*e)) {
+			int explicitExponent = 0;
+			for (; e < end && IsDigit(*e); ++e) {
+				if (explicitExponent < 10000) explicitExponent = explicitExponent * 10 + (*e - '0');
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			p = e;
+		}
+	}
+
+	double result;
+	if (mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22) {
+		result = exponent < 0 ? (double)mantissa / powersOf10[-exponent] : (double)mantissa * powersOf10[exponent];
+		if (negative) result = -result;
+	}
+	else {
+		// Rare: let the C library round long mantissas and large exponents
+		char buffer[128];
+		size_t length = p - start;
+		if (length >= sizeof(buffer)) length = sizeof(buffer) - 1;
+		memcpy(buffer, start, length);
+		buffer[length] = '\0';
+		result = strtod(buffer, NULL);
+	}
+	value = (float)result;
+	return p;
+}
+
+static const char* ParseInt(const char* p, const char* end, long& value)
+{
+	const char* start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+	if (p >= end || !IsDigit(*p)) {
+		return start;
+	}
+	long result = 0;
+	for (; p < end && IsDigit(*p); ++p) {
+		result = result * 10 + (*p - '0');
+	}
+	value = negative ? -result : result;
+	return p;
+}
+
+// OBJ indices are 1-based, negative ones count back from the latest element
+static inline long ResolveIndex(long index, size_t count)
+{
+	if (index > 0) return index - 1;
+	if (index < 0) return (long)count + index;
+	return -1;
+}
+
+struct ObjCorner {
+	long v;
+	long vt;
+	long vn;
+};
+
+// One face corner in any of the forms v, v/vt, v//vn, v/vt/vn
+static const char* ParseCorner(const char* p, const char* end, ObjCorner& corner)
+{
+	corner.vt = 0;
+	corner.vn = 0;
+	const char* next = ParseInt(p, end, corner.v);
+	if (next == p) {
+		return p;
+	}
+	p = next;
+	if (p < end && *p == '/') {
+		++p;
+		p = ParseInt(p, end, corner.vt);
+		if (p < end && *p == '/') {
+			++p;
+			p = ParseInt(p, end, corner.vn);
+		}
+	}
+	return p;
+}
+
+enum ObjRecord {
+	OBJ_OTHER,
+	OBJ_POSITION,
+	OBJ_TEXCOORD,
+	OBJ_NORMAL,
+	OBJ_FACE
+};
+
+// Classifies the line starting at p (after leading blanks) and returns the
+// position just past the record keyword
+static inline ObjRecord ClassifyLine(const char* p, const char* end, const char*& body)
+{
+	if (p + 1 >= end) {
+		return OBJ_OTHER;
+	}
+	if (p[0] == 'v') {
+		if (IsBlank(p[1])) {
+			body = p + 2;
+			return OBJ_POSITION;
+		}
+		if (p + 2 < end && IsBlank(p[2])) {
+			body = p + 3;
+			if (p[1] == 't') return OBJ_TEXCOORD;
+			if (p[1] == 'n') return OBJ_NORMAL;
+		}
+	}
+	else if (p[0] == 'f' && IsBlank(p[1])) {
+		body = p + 2;
+		return OBJ_FACE;
+	}
+	return OBJ_OTHER;
+}
+
+// A newline-aligned slice of the file, parsed independently of the others
+struct ObjChunk {
+	const char* begin;
+	const char* end;
+
+	// Elements in all earlier chunks, needed for relative indices
+	size_t positionBase;
+	size_t texcoordBase;
+	size_t normalBase;
+
+	// Elements in this chunk
+	size_t positionCount;
+	size_t texcoordCount;
+	size_t normalCount;
+
+	std::vector<GLfloat> positions;
+	std::vector<GLfloat> texcoords;
+	std::vector<GLfloat> normals;
+	std::vector<long> corners;		// Global (v, vt, vn) triples, three per triangle
+
+	// Corners welded within this chunk: each distinct triple once, in order
+	// of first use, and every corner as an index into that list
+	std::vector<long> welded;
+	std::vector<GLuint> weldedIndices;
+
+	// Mesh vertex of each welded triple, and the first vertex this chunk adds
+	std::vector<GLuint> remap;
+	size_t vertexBase;
+
+	ObjChunk() : begin(NULL), end(NULL), positionBase(0), texcoordBase(0), normalBase(0),
+		positionCount(0), texcoordCount(0), normalCount(0), vertexBase(0) {}
+};
+
+static void CountObjRecords(ObjChunk& chunk)
+{
+	const char* p = chunk.begin;
+	while (p < chunk.end) {
+		p = SkipBlanks(p, chunk.end);
+		const char* body;
+		switch (ClassifyLine(p, chunk.end, body)) {
+		case OBJ_POSITION: chunk.positionCount++; break;
+		case OBJ_TEXCOORD: chunk.texcoordCount++; break;
+		case OBJ_NORMAL: chunk.normalCount++; break;
+		default: break;
+		}
+		p = NextLine(p, chunk.end);
+	}
+}
+
+static void ParseObjChunk(ObjChunk& chunk)
+{
+	const char* p = chunk.begin;
+	const char* end = chunk.end;
+	size_t positionCount = chunk.positionBase;
+	size_t texcoordCount = chunk.texcoordBase;
+	size_t normalCount = chunk.normalBase;
+
+	ObjCorner corners[3];
+	while (p < end) {
+		p = SkipBlanks(p, end);
+		const char* body = p;
+		switch (ClassifyLine(p, end, body)) {
+		case OBJ_POSITION: {
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			p = ParseFloat(SkipBlanks(body, end), end, x);
+			p = ParseFloat(SkipBlanks(p, end), end, y);
+			p = ParseFloat(SkipBlanks(p, end), end, z);
+			chunk.positions.push_back(x);
+			chunk.positions.push_back(y);
+			chunk.positions.push_back(z);
+			positionCount++;
+			break;
+		}
+		case OBJ_TEXCOORD: {
+			float u = 0.0f, v = 0.0f;
+			p = ParseFloat(SkipBlanks(body, end), end, u);
+			p = ParseFloat(SkipBlanks(p, end), end, v);
+			chunk.texcoords.push_back(u);
+			chunk.texcoords.push_back(v);
+			texcoordCount++;
+			break;
+		}
+		case OBJ_NORMAL: {
+			float x = 0.0f, y = 0.0f, z = 0.0f;
+			p = ParseFloat(SkipBlanks(body, end), end, x);
+			p = ParseFloat(SkipBlanks(p, end), end, y);
+			p = ParseFloat(SkipBlanks(p, end), end, z);
+			chunk.normals.push_back(x);
+			chunk.normals.push_back(y);
+			chunk.normals.push_back(z);
+			normalCount++;
+			break;
+		}
+		case OBJ_FACE: {
+			// Fanned into triangles; a face may only reference earlier elements
+			int cornerCount = 0;
+			p = body;
+			for (;;) {
+				p = SkipBlanks(p, end);
+				ObjCorner corner;
+				const char* next = ParseCorner(p, end, corner);
+				if (next == p) {
+					break;
+				}
+				p = next;
+
+				corner.v = ResolveIndex(corner.v, positionCount);
+				corner.vt = ResolveIndex(corner.vt, texcoordCount);
+				corner.vn = ResolveIndex(corner.vn, normalCount);
+				if (corner.vt >= (long)texcoordCount) {
+					corner.vt = -1;
+				}
+				if (corner.vn >= (long)normalCount) {
+					corner.vn = -1;
+				}
+				if (cornerCount < 2) {
+					corners[cornerCount++] = corner;
+					continue;
+				}
+				corners[2] = corner;
+				cornerCount++;
+
+				bool valid = true;
+				for (int i = 0; i < 3; ++i) {
+					valid = valid && corners[i].v >= 0 && corners[i].v < (long)positionCount;
+				}
+				if (valid) {
+					for (int i = 0; i < 3; ++i) {
+						chunk.corners.push_back(corners[i].v);
+						chunk.corners.push_back(corners[i].vt < 0 ? -1 : corners[i].vt);
+						chunk.corners.push_back(corners[i].vn < 0 ? -1 : corners[i].vn);
+					}
+				}
+				corners[1] = corners[2];
+			}
+			break;
+		}
+		default:
+			break;
+		}
+
+		p = NextLine(p, end);
+	}
+}
+
+// Open-addressing map from a (v, vt, vn) corner to its welded vertex index.
+// Sized once up front, so inserting never allocates.
+struct ObjWeldTable {
+	struct Slot {
+		long v;
+		long vt;
+		long vn;
+		GLuint index;
+	};
+	std::vector<Slot> slots;
+	size_t mask;
+
+	ObjWeldTable(size_t cornerCount) {
+		size_t capacity = 16;
+		while (capacity < cornerCount * 2) capacity <<= 1;
+		Slot empty = { 0, 0, 0, 0xFFFFFFFFu };
+		slots.assign(capacity, empty);
+		mask = capacity - 1;
+	}
+
+	// Returns true when the corner is new; index receives the vertex to use
+	bool insert(long v, long vt, long vn, GLuint nextIndex, GLuint& index) {
+		unsigned long long hash = (unsigned long long)v * 0x9E3779B97F4A7C15ULL;
+		hash ^= (unsigned long long)(vt + 1) * 0xC2B2AE3D27D4EB4FULL;
+		hash ^= (unsigned long long)(vn + 1) * 0x165667B19E3779F9ULL;
+		hash ^= hash >> 29;
+		for (size_t i = (size_t)hash & mask; ; i = (i + 1) & mask) {
+			Slot& slot = slots[i];
+			if (slot.index == 0xFFFFFFFFu) {
+				slot.v = v;
+				slot.vt = vt;
+				slot.vn = vn;
+				slot.index = nextIndex;
+				index = nextIndex;
+				return true;
+			}
+			if (slot.v == v && slot.vt == vt && slot.vn == vn) {
+				index = slot.index;
+				return false;
+			}
+		}
+	}
+};
+
+static void WeldObjChunk(ObjChunk& chunk)
+{
+	const std::vector<long>& corners = chunk.corners;
+	ObjWeldTable table(corners.size() / 3);
+	chunk.weldedIndices.resize(corners.size() / 3);
+	for (size_t c = 0; c < corners.size(); c += 3) {
+		long v = corners[c], vt = corners[c + 1], vn = corners[c + 2];
+		GLuint index;
+		if (table.insert(v, vt, vn, (GLuint)(chunk.welded.size() / 3), index)) {
+			chunk.welded.push_back(v);
+			chunk.welded.push_back(vt);
+			chunk.welded.push_back(vn);
+		}
+		chunk.weldedIndices[c / 3] = index;
+	}
+}
+
+// Runs task(i) for every i in [0, count), one thread per item
+template <typename Task>
+static void ParallelFor(size_t count, Task task)
+{
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < count; ++i) {
+		threads.push_back(std::thread(task, i));
+	}
+	if (count > 0) {
+		task(0);
+	}
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i].join();
+	}
+}
+
+// Files below this size per extra thread are parsed on the calling thread
+static const size_t minChunkBytes = 1 << 20;
+
+void ParseOBJ(const char* data, size_t size, ObjMesh& mesh)
+{
+	// Split into newline-aligned chunks, at most one per core
+	size_t chunkCount = size / minChunkBytes;
+	size_t hardwareThreads = std::thread::hardware_concurrency();
+	if (chunkCount > hardwareThreads) chunkCount = hardwareThreads;
+	if (chunkCount < 1) chunkCount = 1;
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* end = data + size;
+	const char* p = data;
+	for (size_t i = 0; i < chunkCount; ++i) {
+		chunks[i].begin = p;
+		if (i + 1 == chunkCount) {
+			p = end;
+		}
+		else {
+			p = data + size / chunkCount * (i + 1);
+			if (p < chunks[i].begin) p = chunks[i].begin;
+			p = NextLine(p, end);
+		}
+		chunks[i].end = p;
+	}
+
+	// Pass 1: count elements per chunk so relative indices and forward
+	// references resolve exactly as in a single front-to-back scan
+	if (chunkCount > 1) {
+		ParallelFor(chunkCount, [&chunks](size_t i) { CountObjRecords(chunks[i]); });
+		for (size_t i = 1; i < chunkCount; ++i) {
+			chunks[i].positionBase = chunks[i - 1].positionBase + chunks[i - 1].positionCount;
+			chunks[i].texcoordBase = chunks[i - 1].texcoordBase + chunks[i - 1].texcoordCount;
+			chunks[i].normalBase = chunks[i - 1].normalBase + chunks[i - 1].normalCount;
+		}
+	}
+
+	// Pass 2: parse every chunk
+	ParallelFor(chunkCount, [&chunks](size_t i) { ParseObjChunk(chunks[i]); });
+
+	// Gather the attribute pools at prefix-summed offsets
+	std::vector<size_t> positionOffsets(chunkCount + 1, 0);
+	std::vector<size_t> texcoordOffsets(chunkCount + 1, 0);
+	std::vector<size_t> normalOffsets(chunkCount + 1, 0);
+	size_t cornerCount = 0;
+	for (size_t i = 0; i < chunkCount; ++i) {
+		positionOffsets[i + 1] = positionOffsets[i] + chunks[i].positions.size();
+		texcoordOffsets[i + 1] = texcoordOffsets[i] + chunks[i].texcoords.size();
+		normalOffsets[i + 1] = normalOffsets[i] + chunks[i].normals.size();
+		cornerCount += chunks[i].corners.size() / 3;
+	}
+
+	std::vector<GLfloat> positions(positionOffsets[chunkCount]);
+	std::vector<GLfloat> texcoords(texcoordOffsets[chunkCount]);
+	std::vector<GLfloat> normals(normalOffsets[chunkCount]);
+	for (size_t i = 0; i < chunkCount; ++i) {
+		std::copy(chunks[i].positions.begin(), chunks[i].positions.end(), positions.begin() + positionOffsets[i]);
+		std::copy(chunks[i].texcoords.begin(), chunks[i].texcoords.end(), texcoords.begin() + texcoordOffsets[i]);
+		std::copy(chunks[i].normals.begin(), chunks[i].normals.end(), normals.begin() + normalOffsets[i]);
+	}
+
+	// Weld identical (v, vt, vn) corners into one indexed vertex each: every
+	// chunk on its own first, then only the chunks' distinct triples against
+	// each other. Vertices keep the order of first use across the file.
+	ParallelFor(chunkCount, [&chunks](size_t i) { WeldObjChunk(chunks[i]); });
+
+	size_t weldedCount = 0;
+	for (size_t i = 0; i < chunkCount; ++i) {
+		weldedCount += chunks[i].welded.size() / 3;
+	}
+	ObjWeldTable table(chunkCount > 1 ? weldedCount : 0);
+	GLuint vertexCount = 0;
+	for (size_t i = 0; i < chunkCount; ++i) {
+		ObjChunk& chunk = chunks[i];
+		const std::vector<long>& welded = chunk.welded;
+		chunk.vertexBase = vertexCount;
+		chunk.remap.resize(welded.size() / 3);
+		for (size_t w = 0; w < welded.size(); w += 3) {
+			GLuint index = vertexCount;
+			if (chunkCount == 1 || table.insert(welded[w], welded[w + 1], welded[w + 2], vertexCount, index)) {
+				vertexCount++;
+			}
+			chunk.remap[w / 3] = index;
+		}
+	}
+
+	// Fill the vertices each chunk added and its indices, in parallel again
+	bool hasNormals = !normals.empty();
+	mesh.vertices.resize((size_t)vertexCount * 3);
+	mesh.uvs.resize((size_t)vertexCount * 2);
+	mesh.normals.resize(hasNormals ? (size_t)vertexCount * 3 : 0);
+	mesh.indices.resize(cornerCount);
+	std::vector<size_t> indexOffsets(chunkCount, 0);
+	for (size_t i = 1; i < chunkCount; ++i) {
+		indexOffsets[i] = indexOffsets[i - 1] + chunks[i - 1].weldedIndices.size();
+	}
+	ParallelFor(chunkCount, [&](size_t i) {
+		const ObjChunk& chunk = chunks[i];
+		const std::vector<long>& welded = chunk.welded;
+		for (size_t w = 0; w < welded.size(); w += 3) {
+			size_t vertex = chunk.remap[w / 3];
+			if (vertex < chunk.vertexBase) {
+				continue;	// Added by an earlier chunk
+			}
+			long v = welded[w], vt = welded[w + 1], vn = welded[w + 2];
+			mesh.vertices[vertex * 3] = positions[v * 3];
+			mesh.vertices[vertex * 3 + 1] = positions[v * 3 + 1];
+			mesh.vertices[vertex * 3 + 2] = positions[v * 3 + 2];
+			mesh.uvs[vertex * 2] = vt >= 0 ? texcoords[vt * 2] : 0.0f;
+			mesh.uvs[vertex * 2 + 1] = vt >= 0 ? texcoords[vt * 2 + 1] : 0.0f;
+			if (hasNormals) {
+				mesh.normals[vertex * 3] = vn >= 0 ? normals[vn * 3] : 0.0f;
+				mesh.normals[vertex * 3 + 1] = vn >= 0 ? normals[vn * 3 + 1] : 0.0f;
+				mesh.normals[vertex * 3 + 2] = vn >= 0 ? normals[vn * 3 + 2] : 0.0f;
+			}
+		}
+		for (size_t c = 0; c < chunk.weldedIndices.size(); ++c) {
+			mesh.indices[indexOffsets[i] + c] = chunk.remap[chunk.weldedIndices[c]];
+		}
+	});
+}
+
+bool LoadOBJ(const char* filepath, ObjMesh& mesh)
+{
+	PROFILE_SCOPE("LoadOBJ");
+	MappedFile file;
+	if (!file.open(filepath)) {
+		std::cerr << "Error: Cannot open OBJ file " << filepath << std::endl;
+		return false;
+	}
+	ParseOBJ(file.data, file.size, mesh);
+	return true;
+}
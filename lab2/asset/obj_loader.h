@@ -0,0 +1,31 @@
+#ifndef _OBJ_LOADER_H_
+#define _OBJ_LOADER_H_
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <vector>
+
+// CPU-side indexed mesh as produced by the OBJ loader, ready for
+// glBufferData. Every distinct (position, uv, normal) corner of the file is
+// one vertex: vertices holds 3 floats, uvs 2 floats and normals 3 floats per
+// vertex (normals stays empty when the file has none), and indices holds
+// three vertex indices per triangle.
+struct ObjMesh {
+	std::vector<GLfloat> vertices;
+	std::vector<GLfloat> uvs;
+	std::vector<GLfloat> normals;
+	std::vector<GLuint> indices;
+};
+
+// Memory-maps the file and parses it, false if it cannot be opened
+bool LoadOBJ(const char* filepath, ObjMesh& mesh);
+
+// Parses v, vt, vn and f records (v, v/vt, v//vn and v/vt/vn corners,
+// negative indices, polygons fanned into triangles) from a buffer that does
+// not need to be null-terminated, replacing the contents of mesh. Nothing is
+// allocated per line. Large buffers are split into newline-aligned chunks
+// parsed and welded on all cores; the result is identical to a
+// single-threaded parse.
+void ParseOBJ(const char* data, size_t size, ObjMesh& mesh);
+
+#endif
@@ -0,0 +1,180 @@
+#include "benchmark.h"
+
+#include <world/tile.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+static const float benchmarkFrameStep = 1.0f / 60.0f;
+
+static void PrintUsage(const char *program)
+{
+	std::cerr << "Usage: " << program << " [--radius N] [--tile-cache-mb N] [--upload-us N] [--upload-kb N] [--headless] [--frames N] [--tiles N] [--size WxH]"
+		<< " [--report PATH] [--capture N] [--capture-prefix PREFIX] [--bench-kernels]" << std::endl;
+}
+
+static bool ParsePositive(const char *text, int &value)
+{
+	char *end = NULL;
+	long parsed = std::strtol(text, &end, 10);
+	if (end == text || *end != '\0' || parsed < 0 || parsed > 1000000) {
+		return false;
+	}
+	value = (int)parsed;
+	return true;
+}
+
+bool ParseBenchmarkOptions(int argc, char **argv, BenchmarkOptions &options)
+{
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+		bool ok = true;
+
+		if (std::strcmp(arg, "--headless") == 0) {
+			options.headless = true;
+			continue;
+		}
+		if (std::strcmp(arg, "--bench-kernels") == 0) {
+			options.kernelBenchmark = true;
+			continue;
+		}
+		if (value == NULL) {
+			ok = false;
+		}
+		else if (std::strcmp(arg, "--radius") == 0) {
+			ok = ParsePositive(value, options.tileRadius);
+		}
+		else if (std::strcmp(arg, "--tile-cache-mb") == 0) {
+			ok = ParsePositive(value, options.tileCacheMegabytes);
+		}
+		else if (std::strcmp(arg, "--upload-us") == 0) {
+			ok = ParsePositive(value, options.uploadBudgetMicroseconds);
+		}
+		else if (std::strcmp(arg, "--upload-kb") == 0) {
+			ok = ParsePositive(value, options.uploadBudgetKilobytes);
+		}
+		else if (std::strcmp(arg, "--frames") == 0) {
+			ok = ParsePositive(value, options.frames) && options.frames > 0;
+		}
+		else if (std::strcmp(arg, "--tiles") == 0) {
+			ok = ParsePositive(value, options.tiles);
+		}
+		else if (std::strcmp(arg, "--size") == 0) {
+			ok = std::sscanf(value, "%dx%d", &options.width, &options.height) == 2 &&
+				options.width > 0 && options.height > 0;
+		}
+		else if (std::strcmp(arg, "--report") == 0) {
+			options.reportPath = value;
+		}
+		else if (std::strcmp(arg, "--capture") == 0) {
+			ok = ParsePositive(value, options.captureEvery);
+		}
+		else if (std::strcmp(arg, "--capture-prefix") == 0) {
+			options.capturePrefix = value;
+		}
+		else {
+			ok = false;
+		}
+
+		if (!ok) {
+			std::cerr << "Bad argument: " << arg << std::endl;
+			PrintUsage(argv[0]);
+			return false;
+		}
+		i++;
+	}
+	return true;
+}
+
+void BenchmarkCameraPose(const BenchmarkOptions &options, int frame, glm::vec3 &eye, glm::vec3 &target)
+{
+	const float pi = 3.14159265f;
+	float t = options.frames > 1 ? float(frame) / float(options.frames - 1) : 0.0f;
+
+	// Start where the interactive camera does and stay inside the centre row
+	// of tiles, so only the x swaps trigger
+	eye.x = t * options.tiles * tileSize;
+	eye.y = 150.0f * std::sin(t * 4.0f * pi);
+	eye.z = 2500.0f + 400.0f * std::sin(t * 6.0f * pi);
+
+	// Look down -z like the default camera, panning left and right
+	float yaw = -0.5f * pi + 0.6f * std::sin(t * 2.0f * pi);
+	target = eye + glm::vec3(std::cos(yaw), -0.1f, std::sin(yaw)) * 1000.0f;
+}
+
+float BenchmarkFrameTime(int frame)
+{
+	return frame * benchmarkFrameStep;
+}
+
+// Mean, percentile and maximum of the values, written as a JSON object
+static void WriteSummary(std::ostream &out, std::vector<double> values)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < values.size(); i++) {
+		sum += values[i];
+	}
+	std::sort(values.begin(), values.end());
+	size_t count = values.size();
+	double mean = count ? sum / count : 0.0;
+	double p50 = count ? values[(count - 1) / 2] : 0.0;
+	double p95 = count ? values[(count - 1) * 95 / 100] : 0.0;
+	double max = count ? values[count - 1] : 0.0;
+	out << "{ \"count\": " << count << ", \"mean\": " << mean << ", \"p50\": " << p50
+		<< ", \"p95\": " << p95 << ", \"max\": " << max << " }";
+}
+
+bool WriteBenchmarkReport(const BenchmarkOptions &options, const BenchmarkReport &report)
+{
+	std::ofstream out(options.reportPath.c_str());
+	if (!out) {
+		std::cerr << "Failed to write " << options.reportPath << std::endl;
+		return false;
+	}
+	out << std::fixed << std::setprecision(4);
+
+	std::vector<double> cpu, gpu;
+	for (size_t i = 0; i < report.frames.size(); i++) {
+		cpu.push_back(report.frames[i].cpuMilliseconds);
+		if (report.frames[i].gpuMilliseconds >= 0.0) {
+			gpu.push_back(report.frames[i].gpuMilliseconds);
+		}
+	}
+
+	out << "{\n";
+	out << "  \"frames\": " << options.frames << ",\n";
+	out << "  \"tiles\": " << options.tiles << ",\n";
+	out << "  \"width\": " << options.width << ",\n";
+	out << "  \"height\": " << options.height << ",\n";
+	out << "  \"cpu_ms\": ";
+	WriteSummary(out, cpu);
+	out << ",\n  \"gpu_ms\": ";
+	WriteSummary(out, gpu);
+	out << ",\n  \"tile_swap_latency_ms\": ";
+	WriteSummary(out, report.tileSwapLatencies);
+	out << ",\n  \"tile_swaps\": [";
+	for (size_t i = 0; i < report.tileSwapLatencies.size(); i++) {
+		out << (i ? ", " : "") << report.tileSwapLatencies[i];
+	}
+	out << "],\n  \"per_frame\": [\n";
+	for (size_t i = 0; i < report.frames.size(); i++) {
+		const BenchmarkFrame &frame = report.frames[i];
+		out << "    { \"frame\": " << i << ", \"cpu_ms\": " << frame.cpuMilliseconds
+			<< ", \"gpu_ms\": " << frame.gpuMilliseconds << ", \"draws\": " << frame.draws
+			<< ", \"gl_calls\": " << frame.glCallsIssued << ", \"tile_swaps\": " << frame.tileSwaps
+			<< ", \"upload_bytes\": " << frame.uploadBytes
+			<< " }" << (i + 1 < report.frames.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n}\n";
+
+	std::cout << "Benchmark: " << report.frames.size() << " frames, report written to "
+		<< options.reportPath << std::endl;
+	return true;
+}
@@ -0,0 +1,70 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Command line. World options:
+//   --radius N               tiles kept around the camera tile (default 1, 3x3)
+//   --tile-cache-mb N        memory budget of tiles cached after leaving (default 16)
+//   --upload-us N            tile upload time per frame in microseconds, 0 for no limit (default 2000)
+//   --upload-kb N            tile upload bytes per frame in kilobytes, 0 for no limit (default 8192)
+// Headless benchmark:
+//   --headless               render offscreen along the scripted camera path
+//   --frames N               frames to render (default 600)
+//   --tiles N                tiles the path crosses (default 4)
+//   --size WxH               framebuffer size (default 1024x768)
+//   --report PATH            JSON report (default benchmark.json)
+//   --capture N              save every Nth frame as PNG, 0 for none (default 0)
+//   --capture-prefix PREFIX  PNG names are PREFIX_<frame>.png (default frame)
+// Micro-benchmark:
+//   --bench-kernels          time the mat4 kernel sets against glm and exit
+struct BenchmarkOptions {
+	int tileRadius;
+	int tileCacheMegabytes;
+	int uploadBudgetMicroseconds;
+	int uploadBudgetKilobytes;
+	bool headless;
+	bool kernelBenchmark;
+	int frames;
+	int tiles;
+	int width;
+	int height;
+	int captureEvery;
+	std::string reportPath;
+	std::string capturePrefix;
+
+	BenchmarkOptions()
+		: tileRadius(1), tileCacheMegabytes(16), uploadBudgetMicroseconds(2000), uploadBudgetKilobytes(8192), headless(false),
+		kernelBenchmark(false), frames(600), tiles(4), width(1024), height(768),
+		captureEvery(0), reportPath("benchmark.json"), capturePrefix("frame") {}
+};
+
+// Prints usage and returns false on an unknown or malformed argument
+bool ParseBenchmarkOptions(int argc, char **argv, BenchmarkOptions &options);
+
+// Camera of a frame on the scripted path: a weaving flight along +x that
+// covers options.tiles tiles over options.frames frames, panning slowly.
+void BenchmarkCameraPose(const BenchmarkOptions &options, int frame, glm::vec3 &eye, glm::vec3 &target);
+
+// Animation clock of a frame, a fixed step so every run renders the same images
+float BenchmarkFrameTime(int frame);
+
+struct BenchmarkFrame {
+	double cpuMilliseconds;		// Frame start until all GL commands are issued
+	double gpuMilliseconds;		// Timestamp queries around the frame, -1 if unavailable
+	int draws;
+	int glCallsIssued;
+	int tileSwaps;				// Tiles swapped in during this frame
+	size_t uploadBytes;			// Handed to GL by the upload scheduler
+};
+
+struct BenchmarkReport {
+	std::vector<BenchmarkFrame> frames;
+	std::vector<double> tileSwapLatencies;	// Milliseconds from request to swapped in
+};
+
+bool WriteBenchmarkReport(const BenchmarkOptions &options, const BenchmarkReport &report);
+
+#endif
@@ -0,0 +1,193 @@
+#include "kernel_benchmark.h"
+
+#include <anim/mat4_kernels.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Random joint data shaped like an animated skeleton: every joint has an
+// earlier parent, rotations are unit quaternions, scales stay near one
+struct KernelBenchmarkData {
+	std::vector<int> parents;
+	std::vector<glm::vec3> translations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::quat> targets;
+	std::vector<float> weights;
+	std::vector<glm::mat4> locals;
+	std::vector<glm::mat4> inverseBinds;
+	std::vector<int> skinJoints;
+};
+
+static float BenchmarkRandom(unsigned &state)
+{
+	state = state * 1664525u + 1013904223u;
+	return (state >> 8) * (1.0f / 16777216.0f);
+}
+
+static glm::quat RandomRotation(unsigned &state)
+{
+	glm::vec3 axis(BenchmarkRandom(state) - 0.5f, BenchmarkRandom(state) - 0.5f, BenchmarkRandom(state) - 0.5f);
+	float angle = BenchmarkRandom(state) * 6.2831853f;
+	return glm::angleAxis(angle, glm::normalize(axis + glm::vec3(1e-3f)));
+}
+
+static void MakeBenchmarkData(int joints, KernelBenchmarkData &data)
+{
+	unsigned state = 12345u;
+	for (int j = 0; j < joints; j++) {
+		data.parents.push_back(j == 0 ? -1 : (j - 1) / 2);
+		data.translations.push_back(glm::vec3(BenchmarkRandom(state), BenchmarkRandom(state), BenchmarkRandom(state)));
+		data.scales.push_back(glm::vec3(0.9f + 0.2f * BenchmarkRandom(state)));
+		data.rotations.push_back(RandomRotation(state));
+		data.targets.push_back(RandomRotation(state));
+		data.weights.push_back(BenchmarkRandom(state));
+		data.skinJoints.push_back(joints - 1 - j);
+	}
+	data.locals.resize(joints);
+	data.inverseBinds.resize(joints);
+	Mat4KernelSet(Mat4KernelsGlm)->composeTRS(data.translations.data(), data.rotations.data(), data.scales.data(),
+		data.locals.data(), joints);
+	for (int j = 0; j < joints; j++) {
+		data.inverseBinds[j] = glm::inverse(data.locals[joints - 1 - j]);
+	}
+}
+
+static float MaxDifference(const float *a, const float *b, size_t count)
+{
+	float difference = 0.0f;
+	for (size_t i = 0; i < count; i++) {
+		difference = std::max(difference, std::fabs(a[i] - b[i]));
+	}
+	return difference;
+}
+
+// Runs the kernel until roughly two million joints went through it, after a
+// warm-up pass, and returns nanoseconds per joint
+template <typename Kernel>
+static double TimeKernel(int joints, Kernel kernel)
+{
+	int iterations = std::max(1, 2000000 / joints);
+	kernel();
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		kernel();
+	}
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+	return elapsed.count() / ((double)iterations * joints);
+}
+
+struct MultiplyRun {
+	const Mat4Kernels *kernels;
+	const KernelBenchmarkData *data;
+	glm::mat4 *out;
+	void operator()() const
+	{
+		kernels->multiply(data->locals.data(), data->skinJoints.data(), data->inverseBinds.data(), out,
+			data->locals.size());
+	}
+};
+
+struct PropagateRun {
+	const Mat4Kernels *kernels;
+	const KernelBenchmarkData *data;
+	glm::mat4 *out;
+	void operator()() const
+	{
+		kernels->propagate(data->parents.data(), data->locals.data(), out, data->locals.size());
+	}
+};
+
+struct ComposeRun {
+	const Mat4Kernels *kernels;
+	const KernelBenchmarkData *data;
+	glm::mat4 *out;
+	void operator()() const
+	{
+		kernels->composeTRS(data->translations.data(), data->rotations.data(), data->scales.data(), out,
+			data->locals.size());
+	}
+};
+
+struct SlerpRun {
+	const Mat4Kernels *kernels;
+	const KernelBenchmarkData *data;
+	glm::quat *out;
+	void operator()() const
+	{
+		kernels->slerp(data->rotations.data(), data->targets.data(), data->weights.data(), out,
+			data->rotations.size());
+	}
+};
+
+static void PrintKernelResult(const char *kernel, double nanoseconds, float error)
+{
+	std::cout << "  " << std::left << std::setw(12) << kernel << std::right << std::setw(9) << nanoseconds
+		<< " ns/joint   max error " << std::scientific << std::setprecision(2) << error << std::fixed
+		<< std::setprecision(2) << std::endl;
+}
+
+int RunMat4KernelBenchmark()
+{
+	static const int jointCounts[] = { 25, 100, 1000 };
+	static const Mat4KernelLevel levels[] = { Mat4KernelsGlm, Mat4KernelsSse2, Mat4KernelsAvx2 };
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Mat4 kernels, active set: " << ActiveMat4Kernels().name << std::endl;
+	for (size_t c = 0; c < sizeof(jointCounts) / sizeof(jointCounts[0]); c++) {
+		int joints = jointCounts[c];
+		KernelBenchmarkData data;
+		MakeBenchmarkData(joints, data);
+
+		// The glm results every other set is compared with
+		const Mat4Kernels *reference = Mat4KernelSet(Mat4KernelsGlm);
+		std::vector<glm::mat4> referenceMultiply(joints), referencePropagate(joints), referenceCompose(joints);
+		std::vector<glm::quat> referenceSlerp(joints);
+		MultiplyRun multiplyReference = { reference, &data, referenceMultiply.data() };
+		PropagateRun propagateReference = { reference, &data, referencePropagate.data() };
+		ComposeRun composeReference = { reference, &data, referenceCompose.data() };
+		SlerpRun slerpReference = { reference, &data, referenceSlerp.data() };
+		multiplyReference();
+		propagateReference();
+		composeReference();
+		slerpReference();
+
+		std::vector<glm::mat4> matrices(joints);
+		std::vector<glm::quat> quats(joints);
+		const float *matrixValues = &matrices[0][0][0];
+		const float *quatValues = &quats[0][0];
+		size_t matrixFloats = joints * 16, quatFloats = joints * 4;
+
+		for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+			const Mat4Kernels *kernels = Mat4KernelSet(levels[l]);
+			if (kernels == NULL) {
+				continue;
+			}
+			std::cout << joints << " joints, " << kernels->name << std::endl;
+
+			MultiplyRun multiply = { kernels, &data, matrices.data() };
+			double nanoseconds = TimeKernel(joints, multiply);
+			PrintKernelResult("multiply", nanoseconds,
+				MaxDifference(matrixValues, &referenceMultiply[0][0][0], matrixFloats));
+
+			PropagateRun propagate = { kernels, &data, matrices.data() };
+			nanoseconds = TimeKernel(joints, propagate);
+			PrintKernelResult("propagate", nanoseconds,
+				MaxDifference(matrixValues, &referencePropagate[0][0][0], matrixFloats));
+
+			ComposeRun compose = { kernels, &data, matrices.data() };
+			nanoseconds = TimeKernel(joints, compose);
+			PrintKernelResult("composeTRS", nanoseconds,
+				MaxDifference(matrixValues, &referenceCompose[0][0][0], matrixFloats));
+
+			SlerpRun slerp = { kernels, &data, quats.data() };
+			nanoseconds = TimeKernel(joints, slerp);
+			PrintKernelResult("slerp", nanoseconds, MaxDifference(quatValues, &referenceSlerp[0][0], quatFloats));
+		}
+	}
+	return 0;
+}
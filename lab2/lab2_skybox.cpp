@@ -13,8 +13,31 @@
 #include <iomanip>
 
 #include <render/shader.h>
+#include <render/texture.h>
+#include <render/mesh_registry.h>
+#include <render/frustum.h>
+#include <render/render_queue.h>
+#include <render/gl_state.h>
+#include <render/frame_constants.h>
+#include <render/gpu_timer.h>
+#include <render/offscreen_target.h>
+#include <render/pixel_upload.h>
+#include <render/upload_scheduler.h>
+#include <bench/benchmark.h>
+#include <bench/kernel_benchmark.h>
+#include <profile/frame_stats.h>
+#include <profile/profiler.h>
+#include <profile/alloc_check.h>
+#include <asset/obj_loader.h>
+#include <anim/animation.h>
+#include <anim/skeleton.h>
+#include <world/tile_streamer.h>
+#include <world/tile_manager.h>
+#include <world/tile_random.h>
 #include <vector>
+#include <algorithm>
 #include <iostream>
+#include <cstdio>
 #define _USE_MATH_DEFINES
 #include <math.h>
 #define BUFFER_OFFSET(i) ((char *)NULL + (i))
@@ -38,14 +61,15 @@ static float playbackSpeed = 2.0f;
 static glm::vec3 lightIntensity(5e6f, 5e6f, 5e6f);
 static glm::vec3 lightPosition(-275.0f, 500.0f, 800.0f);
 
+// Frame time percentiles and hitches, F prints them
+static FrameStats frameStats;
+
 
 
 struct MyBot {
 	// Shader variable IDs
-	GLuint mvpMatrixID;
+	GLuint modelMatrixID;
 	GLuint jointMatricesID;
-	GLuint lightPositionID;
-	GLuint lightIntensityID;
 	GLuint programID;
 
 	tinygltf::Model model;
@@ -57,347 +81,44 @@ struct MyBot {
 	};
 	std::vector<PrimitiveObject> primitiveObjects;
 
-	// Skinning
-	struct SkinObject {
-		// Transforms the geometry into the space of the respective joint
-		std::vector<glm::mat4> inverseBindMatrices;
-
-		// Transforms the geometry following the movement of the joints
-		std::vector<glm::mat4> globalJointTransforms;
-
-		// Combined transforms
-		std::vector<glm::mat4> jointMatrices;
-	};
-	std::vector<SkinObject> skinObjects;
-
-	// Animation
-	struct SamplerObject {
-		std::vector<float> input;
-		std::vector<glm::vec4> output;
-		int interpolation;
-	};
-	struct ChannelObject {
-		int sampler;
-		std::string targetPath;
-		int targetNode;
-	};
-	struct AnimationObject {
-		std::vector<SamplerObject> samplers;	// Animation data
-	};
-	std::vector<AnimationObject> animationObjects;
-
-	glm::mat4 getNodeTransform(const tinygltf::Node& node) {
-		glm::mat4 transform(1.0f);
-
-		if (node.matrix.size() == 16) {
-			transform = glm::make_mat4(node.matrix.data());
-		}
-		else {
-			if (node.translation.size() == 3) {
-				transform = glm::translate(transform, glm::vec3(node.translation[0], node.translation[1], node.translation[2]));
-			}
-			if (node.rotation.size() == 4) {
-				glm::quat q(node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
-				transform *= glm::mat4_cast(q);
-			}
-			if (node.scale.size() == 3) {
-				transform = glm::scale(transform, glm::vec3(node.scale[0], node.scale[1], node.scale[2]));
-			}
-		}
-		return transform;
-	}
-
-	void computeLocalNodeTransform(const tinygltf::Model& model,
-		int nodeIndex,
-		std::vector<glm::mat4>& localTransforms)
-	{
-		const tinygltf::Node& node = model.nodes[nodeIndex];
-		glm::mat4 transform = glm::mat4(1.0f);
-
-		// Combine translation, rotation, and scale if present
-		if (node.matrix.size() == 16) {
-			transform = glm::make_mat4(node.matrix.data());
-		}
-		else {
-			if (node.translation.size() == 3) {
-				transform = glm::translate(transform, glm::vec3(
-					node.translation[0], node.translation[1], node.translation[2]));
-			}
-			if (node.rotation.size() == 4) {
-				glm::quat rotation = glm::quat(
-					node.rotation[3], node.rotation[0], node.rotation[1], node.rotation[2]);
-				transform *= glm::mat4_cast(rotation);
-			}
-			if (node.scale.size() == 3) {
-				transform = glm::scale(transform, glm::vec3(
-					node.scale[0], node.scale[1], node.scale[2]));
-			}
-		}
-
-		localTransforms[nodeIndex] = transform;
-
-		// Recursively compute local transforms for child nodes
-		for (const int childIndex : node.children) {
-			computeLocalNodeTransform(model, childIndex, localTransforms);
-		}
-	}
-
-	void computeGlobalNodeTransform(const tinygltf::Model& model,
-		const std::vector<glm::mat4>& localTransforms,
-		int nodeIndex, const glm::mat4& parentTransform,
-		std::vector<glm::mat4>& globalTransforms)
-	{
-		globalTransforms[nodeIndex] = parentTransform * localTransforms[nodeIndex];
-
-		// Recursively compute global transforms for child nodes
-		const tinygltf::Node& node = model.nodes[nodeIndex];
-		for (const int childIndex : node.children) {
-			computeGlobalNodeTransform(model, localTransforms, childIndex, globalTransforms[nodeIndex], globalTransforms);
-		}
-	}
-
-	std::vector<SkinObject> prepareSkinning(const tinygltf::Model& model) {
-		std::vector<SkinObject> skinObjects;
-
-		// In our Blender exporter, the default number of joints that may influence a vertex is set to 4, just for convenient implementation in shaders.
-
-		for (size_t i = 0; i < model.skins.size(); i++) {
-			SkinObject skinObject;
-
-			const tinygltf::Skin& skin = model.skins[i];
-
-			// Read inverseBindMatrices
-			const tinygltf::Accessor& accessor = model.accessors[skin.inverseBindMatrices];
-			assert(accessor.type == TINYGLTF_TYPE_MAT4);
-			const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-			const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
-			const float* ptr = reinterpret_cast<const float*>(
-				buffer.data.data() + accessor.byteOffset + bufferView.byteOffset);
-
-			skinObject.inverseBindMatrices.resize(accessor.count);
-			for (size_t j = 0; j < accessor.count; j++) {
-				float m[16];
-				memcpy(m, ptr + j * 16, 16 * sizeof(float));
-				skinObject.inverseBindMatrices[j] = glm::make_mat4(m);
-			}
-
-			assert(skin.joints.size() == accessor.count);
-
-			skinObject.globalJointTransforms.resize(skin.joints.size());
-			skinObject.jointMatrices.resize(skin.joints.size());
-
-			// ----------------------------------------------
-			// Compute local transforms at each node
-			int rootNodeIndex = skin.joints[0];
-			std::vector<glm::mat4> localNodeTransforms(skin.joints.size());
-			computeLocalNodeTransform(model, rootNodeIndex, localNodeTransforms);
-
-			// Compute global transforms at each node
-			glm::mat4 parentTransform(1.0f);
-			computeGlobalNodeTransform(model, localNodeTransforms, rootNodeIndex, parentTransform, skinObject.globalJointTransforms);
-
-			// Compute the inverseBindMatrix
-			for (int j = 0; j < skinObject.jointMatrices.size(); j++) {
-				skinObject.jointMatrices[j] = skinObject.globalJointTransforms[skin.joints[j]] * skinObject.inverseBindMatrices[j];
-			}
-			// ----------------------------------------------
-			skinObjects.push_back(skinObject);
-		}
-		return skinObjects;
-	}
-
-	int findKeyframeIndex(const std::vector<float>& times, float animationTime)
-	{
-		int left = 0;
-		int right = times.size() - 1;
-
-		while (left <= right) {
-			int mid = (left + right) / 2;
-
-			if (mid + 1 < times.size() && times[mid] <= animationTime && animationTime < times[mid + 1]) {
-				return mid;
-			}
-			else if (times[mid] > animationTime) {
-				right = mid - 1;
-			}
-			else { // animationTime >= times[mid + 1]
-				left = mid + 1;
-			}
-		}
-
-		// Target not found
-		return times.size() - 2;
-	}
-
-	std::vector<AnimationObject> prepareAnimation(const tinygltf::Model& model)
-	{
-		std::vector<AnimationObject> animationObjects;
-		for (const auto& anim : model.animations) {
-			AnimationObject animationObject;
-
-			for (const auto& sampler : anim.samplers) {
-				SamplerObject samplerObject;
-
-				const tinygltf::Accessor& inputAccessor = model.accessors[sampler.input];
-				const tinygltf::BufferView& inputBufferView = model.bufferViews[inputAccessor.bufferView];
-				const tinygltf::Buffer& inputBuffer = model.buffers[inputBufferView.buffer];
-
-				assert(inputAccessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-				assert(inputAccessor.type == TINYGLTF_TYPE_SCALAR);
-
-				// Input (time) values
-				samplerObject.input.resize(inputAccessor.count);
+	// Skinning, the joints of the first skin
+	Skeleton skeleton;
 
-				const unsigned char* inputPtr = &inputBuffer.data[inputBufferView.byteOffset + inputAccessor.byteOffset];
-				const float* inputBuf = reinterpret_cast<const float*>(inputPtr);
+	// Transforms the geometry following the movement of the joints, in
+	// skeleton order
+	std::vector<glm::mat4> globalJointTransforms;
 
-				// Read input (time) values
-				int stride = inputAccessor.ByteStride(inputBufferView);
-				for (size_t i = 0; i < inputAccessor.count; ++i) {
-					samplerObject.input[i] = *reinterpret_cast<const float*>(inputPtr + i * stride);
-				}
-
-				const tinygltf::Accessor& outputAccessor = model.accessors[sampler.output];
-				const tinygltf::BufferView& outputBufferView = model.bufferViews[outputAccessor.bufferView];
-				const tinygltf::Buffer& outputBuffer = model.buffers[outputBufferView.buffer];
-
-				assert(outputAccessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-				const unsigned char* outputPtr = &outputBuffer.data[outputBufferView.byteOffset + outputAccessor.byteOffset];
-				const float* outputBuf = reinterpret_cast<const float*>(outputPtr);
-
-				int outputStride = outputAccessor.ByteStride(outputBufferView);
-
-				// Output values
-				samplerObject.output.resize(outputAccessor.count);
-
-				for (size_t i = 0; i < outputAccessor.count; ++i) {
-
-					if (outputAccessor.type == TINYGLTF_TYPE_VEC3) {
-						memcpy(&samplerObject.output[i], outputPtr + i * 3 * sizeof(float), 3 * sizeof(float));
-					}
-					else if (outputAccessor.type == TINYGLTF_TYPE_VEC4) {
-						memcpy(&samplerObject.output[i], outputPtr + i * 4 * sizeof(float), 4 * sizeof(float));
-					}
-					else {
-						std::cout << "Unsupport accessor type ..." << std::endl;
-					}
-
-				}
-
-				animationObject.samplers.push_back(samplerObject);
-			}
-
-			animationObjects.push_back(animationObject);
-		}
-		return animationObjects;
-	}
-
-	void updateAnimation(
-		const tinygltf::Model& model,
-		const tinygltf::Animation& anim,
-		const AnimationObject& animationObject,
-		float time,
-		std::vector<glm::mat4>& nodeTransforms)
-	{
-		// There are many channels so we have to accumulate the transforms
-		for (const auto& channel : anim.channels) {
-
-			int targetNodeIndex = channel.target_node;
-			const auto& sampler = anim.samplers[channel.sampler];
-
-			// Access output (value) data for the channel
-			const tinygltf::Accessor& outputAccessor = model.accessors[sampler.output];
-			const tinygltf::BufferView& outputBufferView = model.bufferViews[outputAccessor.bufferView];
-			const tinygltf::Buffer& outputBuffer = model.buffers[outputBufferView.buffer];
-
-			// Calculate current animation time (wrap if necessary)
-			const std::vector<float>& times = animationObject.samplers[channel.sampler].input;
-			float animationTime = fmod(time, times.back());
-
-			// ----------------------------------------------------------
-			// TODO: Find a keyframe for getting animation data
-			// ----------------------------------------------------------
-			int keyframeIndex = findKeyframeIndex(times, fmod(time, times.back()));
-			float t = (fmod(time, times.back()) - times[keyframeIndex]) /
-				(times[keyframeIndex + 1] - times[keyframeIndex]);
-
-			const unsigned char* outputPtr = &outputBuffer.data[outputBufferView.byteOffset + outputAccessor.byteOffset];
-
-			const float* outputBuf = reinterpret_cast<const float*>(outputPtr);
-
-			// -----------------------------------------------------------
-			// TODO: Add interpolation for smooth animation
-			// -----------------------------------------------------------
-			if (channel.target_path == "translation") {
-				glm::vec3 translation0, translation1;
-				memcpy(&translation0, outputPtr + keyframeIndex * 3 * sizeof(float), 3 * sizeof(float));
-
-				glm::vec3 translation = translation0;
-				nodeTransforms[targetNodeIndex] = glm::translate(nodeTransforms[targetNodeIndex], translation);
-			}
-			else if (channel.target_path == "rotation") {
-				glm::quat rotation0, rotation1;
-				memcpy(&rotation0, outputPtr + keyframeIndex * 4 * sizeof(float), 4 * sizeof(float));
-
-				glm::quat rotation = rotation0;
-				nodeTransforms[targetNodeIndex] *= glm::mat4_cast(rotation);
-			}
-			else if (channel.target_path == "scale") {
-				glm::vec3 scale0, scale1;
-				memcpy(&scale0, outputPtr + keyframeIndex * 3 * sizeof(float), 3 * sizeof(float));
-
-				glm::vec3 scale = scale0;
-				nodeTransforms[targetNodeIndex] = glm::scale(nodeTransforms[targetNodeIndex], scale);
-			}
-		}
-	}
+	// Global times inverse bind matrix, in skin order for the shader
+	std::vector<glm::mat4> jointMatrices;
 
-	void updateSkinning(const std::vector<glm::mat4>& nodeTransforms) {
-		const tinygltf::Skin& skin = model.skins[0];
-		int rootNodeIndex = skin.joints[0];
-		std::vector<glm::mat4> localNodeTransforms(skin.joints.size());
-		computeLocalNodeTransform(model, rootNodeIndex, localNodeTransforms);
+	// Animation, one clip per glTF animation over the skeleton joints
+	std::vector<AnimationClip> animationClips;
+	AnimationCursor animationCursor;
+	JointPoses jointPoses;
 
-		// Compute global transforms at each node
-		glm::mat4 parentTransform(1.0f);
-		computeGlobalNodeTransform(model, localNodeTransforms, rootNodeIndex, parentTransform, skinObjects[0].globalJointTransforms);
+	// Scratch of update, sized once so a frame does not touch the heap
+	std::vector<glm::mat4> localJointTransforms;
+	bool animationWarm;		// After the first update, which sizes the cursor
 
-		// Compute the inverseBindMatrix
-		for (int j = 0; j < skinObjects[0].jointMatrices.size(); j++) {
-			skinObjects[0].jointMatrices[j] = nodeTransforms[skin.joints[j]] * skinObjects[0].inverseBindMatrices[j];
-		}
+	// Pose to joint matrices: local, then global in one forward pass, then skin
+	void updateSkinning(const JointPoses& poses) {
+		ComposeLocalTransforms(poses, localJointTransforms.data());
+		ComputeGlobalTransforms(skeleton, localJointTransforms.data(), globalJointTransforms.data());
+		ComputeJointMatrices(skeleton, globalJointTransforms.data(), jointMatrices.data());
 	}
 
 	void update(float time) {
-
-		if (model.animations.size() > 0) {
-			const tinygltf::Animation& animation = model.animations[0];
-			const AnimationObject& animationObject = animationObjects[0];
-
-			const tinygltf::Skin& skin = model.skins[0];
-			std::vector<glm::mat4> nodeTransforms(skin.joints.size());
-			for (size_t i = 0; i < nodeTransforms.size(); ++i) {
-				nodeTransforms[i] = glm::mat4(1.0);
-			}
-
-			updateAnimation(model, animation, animationObject, time, nodeTransforms);
-
-			// ----------------------------------------------
-			// TODO: Recompute global transforms at each node
-			// using the updated node transforms above
-			// ----------------------------------------------
-			// Compute global transforms for all nodes using the updated node transforms
-			std::vector<glm::mat4> globalTransforms = skinObjects[0].globalJointTransforms;
-			glm::mat4 parentTransform = glm::mat4(1.0f); // Root transform (identity)
-
-			int rootNodeIndex = skin.joints[0]; // Assuming the first joint is the root
-			computeGlobalNodeTransform(model, nodeTransforms, rootNodeIndex, parentTransform, globalTransforms);
-			updateSkinning(globalTransforms);
-			// Store the global transforms for rendering the skeleton
-			skinObjects[0].globalJointTransforms = globalTransforms;
+		PROFILE_SCOPE("MyBot::update");
+		PROFILE_NO_ALLOC_SCOPE("MyBot::update", animationWarm);
+
+		if (animationClips.size() > 0) {
+			// Joints without tracks keep their rest transform. Same sizes, so
+			// the copy reuses the storage.
+			jointPoses = skeleton.restPoses;
+			SampleAnimationClip(animationClips[0], time, animationCursor, jointPoses);
+			updateSkinning(jointPoses);
+			animationWarm = true;
 		}
-
 	}
 
 	bool loadModel(tinygltf::Model& model, const char* filename) {
@@ -423,6 +144,8 @@ struct MyBot {
 	}
 
 	void initialize() {
+		PROFILE_SCOPE("MyBot::initialize");
+		animationWarm = false;
 		// Modify your path if needed
 		if (!loadModel(model, "../../../lab2/models/bot/bot.gltf")) {
 			return;
@@ -431,29 +154,38 @@ struct MyBot {
 		// Prepare buffers for rendering
 		primitiveObjects = bindModel(model);
 
-		// Prepare joint matrices
-		skinObjects = prepareSkinning(model);
-
-		// Prepare animation data
-		animationObjects = prepareAnimation(model);
+		// Compile the skeleton, resolve the animation channels to its joints
+		// and start from the rest pose
+		if (!model.skins.empty()) {
+			CompileSkeleton(model, model.skins[0], skeleton);
+			animationClips.resize(model.animations.size());
+			for (size_t i = 0; i < model.animations.size(); ++i) {
+				CompileAnimationClip(model, model.animations[i], skeleton.jointNodes, animationClips[i]);
+			}
+			localJointTransforms.resize(skeleton.jointCount());
+			globalJointTransforms.resize(skeleton.jointCount());
+			jointMatrices.resize(skeleton.jointCount());
+			updateSkinning(skeleton.restPoses);
+		}
 
 		// Create and compile our GLSL program from the shaders
-		programID = LoadShadersFromFile("../../../lab2/shaders/bot.vert", "../../../lab2/shaders/bot.frag");
+		programID = AcquireProgram("../../../lab2/shaders/bot.vert", "../../../lab2/shaders/bot.frag");
 		if (programID == 0)
 		{
 			std::cerr << "Failed to load shaders." << std::endl;
 		}
 
 		// Get a handle for GLSL variables
-		mvpMatrixID = glGetUniformLocation(programID, "MVP");
+		modelMatrixID = glGetUniformLocation(programID, "model");
 		jointMatricesID = glGetUniformLocation(programID, "u_jointMat");
-		lightPositionID = glGetUniformLocation(programID, "lightPosition");
-		lightIntensityID = glGetUniformLocation(programID, "lightIntensity");
 	}
 
 	void bindMesh(std::vector<PrimitiveObject>& primitiveObjects,
 		tinygltf::Model& model, tinygltf::Mesh& mesh) {
 
+		// Index buffers bind to the current VAO, make sure it is none
+		CachedBindVertexArray(0);
+
 		std::map<int, GLuint> vbos;
 		for (size_t i = 0; i < model.bufferViews.size(); ++i) {
 			const tinygltf::BufferView& bufferView = model.bufferViews[i];
@@ -471,7 +203,7 @@ struct MyBot {
 			const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
 			GLuint vbo;
 			glGenBuffers(1, &vbo);
-			glBindBuffer(target, vbo);
+			CachedBindBuffer(target, vbo);
 			glBufferData(target, bufferView.byteLength,
 				&buffer.data.at(0) + bufferView.byteOffset, GL_STATIC_DRAW);
 
@@ -487,13 +219,13 @@ struct MyBot {
 
 			GLuint vao;
 			glGenVertexArrays(1, &vao);
-			glBindVertexArray(vao);
+			CachedBindVertexArray(vao);
 
 			for (auto& attrib : primitive.attributes) {
 				tinygltf::Accessor accessor = model.accessors[attrib.second];
 				int byteStride =
 					accessor.ByteStride(model.bufferViews[accessor.bufferView]);
-				glBindBuffer(GL_ARRAY_BUFFER, vbos[accessor.bufferView]);
+				CachedBindBuffer(GL_ARRAY_BUFFER, vbos[accessor.bufferView]);
 
 				int size = 1;
 				if (accessor.type != TINYGLTF_TYPE_SCALAR) {
@@ -516,6 +248,7 @@ struct MyBot {
 					std::cout << "vaa missing: " << attrib.first << std::endl;
 				}
 			}
+			CachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos[indexAccessor.bufferView]);
 
 			// Record VAO for later use
 			PrimitiveObject primitiveObject;
@@ -523,7 +256,7 @@ struct MyBot {
 			primitiveObject.vbos = vbos;
 			primitiveObjects.push_back(primitiveObject);
 
-			glBindVertexArray(0);
+			CachedBindVertexArray(0);
 		}
 	}
 
@@ -560,20 +293,16 @@ struct MyBot {
 		for (size_t i = 0; i < mesh.primitives.size(); ++i)
 		{
 			GLuint vao = primitiveObjects[i].vao;
-			std::map<int, GLuint> vbos = primitiveObjects[i].vbos;
 
-			glBindVertexArray(vao);
+			CachedBindVertexArray(vao);
 
 			tinygltf::Primitive primitive = mesh.primitives[i];
 			tinygltf::Accessor indexAccessor = model.accessors[primitive.indices];
 
-			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbos.at(indexAccessor.bufferView));
-
+			// The index buffer is part of the VAO, see bindMesh
 			glDrawElements(primitive.mode, indexAccessor.count,
 				indexAccessor.componentType,
 				BUFFER_OFFSET(indexAccessor.byteOffset));
-
-			glBindVertexArray(0);
 		}
 	}
 
@@ -596,739 +325,294 @@ struct MyBot {
 		}
 	}
 
-	void render(glm::mat4 cameraMatrix) {
-		glUseProgram(programID);
+	// Camera and light come from the FrameConstants block
+	void render() {
+		PROFILE_GPU_SCOPE("MyBot::render");
+		CachedUseProgram(programID);
 		glm::vec3 position = glm::vec3(-500.0f, -470.0f, 1000.0f); // Modify these values to move the bot
 		glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), position);
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
+		glUniformMatrix4fv(modelMatrixID, 1, GL_FALSE, &modelMatrix[0][0]);
 
 		// -----------------------------------------------------------------
 		// TODO: Set animation data for linear blend skinning in shader
 		// -----------------------------------------------------------------
-		const std::vector<glm::mat4>& jointMatrices = skinObjects[0].jointMatrices;
 		glUniformMatrix4fv(jointMatricesID, jointMatrices.size(), GL_FALSE, glm::value_ptr(jointMatrices[0]));
 
 		// -----------------------------------------------------------------
 
-		// Set light data
-		glUniform3fv(lightPositionID, 1, &lightPosition[0]);
-		glUniform3fv(lightIntensityID, 1, &lightIntensity[0]);
-
 		// Draw the GLTF model
 		drawModel(primitiveObjects, model);
 	}
 
 	void cleanup() {
-		glDeleteProgram(programID);
+		ReleaseProgram(programID);
 	}
 };
 
-void loadOBJfromTinkerCad(const char* filepath, std::vector<GLfloat>& vertices,
-	std::vector<GLfloat>& uvs, std::vector<GLuint>& indices) {
-	std::ifstream file(filepath);
-	if (!file.is_open()) {
-		std::cerr << "Error: Cannot open OBJ file " << filepath << std::endl;
-		return;
-	}
-
-	std::string line;
-	std::vector<glm::vec3> temp_vertices;
-	std::vector<glm::vec2> temp_uvs;
-	bool hasUVs = false;
-
-	while (std::getline(file, line)) {
-
-		std::istringstream ss(line);
-		std::string prefix;
-		ss >> prefix;
-
-		if (prefix == "v") { // Vertex
-			glm::vec3 vertex;
-			ss >> vertex.x >> vertex.y >> vertex.z;
-			temp_vertices.push_back(vertex);
-		}
-		else if (prefix == "vt") { // Texture coordinate
-			glm::vec2 uv;
-			ss >> uv.x >> uv.y;
-			temp_uvs.push_back(uv);
-			hasUVs = true; // Set the flag since we found a vt line
-		}
-		else if (prefix == "f") { // Face
-			GLuint vertexIndex[3], uvIndex[3];
-			char separator;
-			if (hasUVs) {
-				for (int i = 0; i < 3; ++i) {
-					ss >> vertexIndex[i] >> separator >> uvIndex[i];
-					indices.push_back(vertexIndex[i] - 1);
-				}
-
-				for (int i = 0; i < 3; ++i)
-				{
-					uvs.push_back(temp_uvs[uvIndex[i] - 1].x);
-					uvs.push_back(temp_uvs[uvIndex[i] - 1].y);
-				}
-			}
-			else {
-				for (int i = 0; i < 3; ++i) {
-					ss >> vertexIndex[i];
-					indices.push_back(vertexIndex[i] - 1);
-				}
-				for (int i = 0; i < 3; i++) {
-					uvs.push_back(0.0f);
-					uvs.push_back(0.0f);
-				}
-			}
-		}
-	}
-
-	for (const auto& v : temp_vertices) {
-		vertices.push_back(v.x);
-		vertices.push_back(v.y);
-		vertices.push_back(v.z);
+static void IslandColors(size_t vertexCount, GLfloat* colors) {
+	// Generate brownish colors with different lighting
+	for (size_t i = 0; i < vertexCount; ++i) {
+		float intensity = 0.5f + 0.5f * (static_cast<float>(i) / static_cast<float>(vertexCount)); // Vary intensity from 0.5 to 1.0
+		float red = 0.6f * intensity;   // Base red with intensity adjustment
+		float green = 0.4f * intensity; // Base green with intensity adjustment
+		float blue = 0.2f * intensity;  // Base blue with intensity adjustment (kept low for brown tone)
+
+		colors[i * 3] = red;   // Red
+		colors[i * 3 + 1] = green; // Green
+		colors[i * 3 + 2] = blue;  // Blue
 	}
 }
-void betterLoader(const char* filepath, std::vector<GLfloat>& vertices,
-	std::vector<GLfloat>& uvs, std::vector<GLuint>& indices) {
-	std::ifstream file(filepath);
-	if (!file.is_open()) {
-		std::cerr << "Error: Cannot open OBJ file " << filepath << std::endl;
-		return;
-	}
 
-	std::string line;
-	std::vector<glm::vec3> temp_vertices;
-	std::vector<glm::vec2> temp_uvs;
-	bool hasUVs = false;
+struct Island {
+	glm::vec3 position;
+	glm::vec3 scale;
+	char* texture;
 
-	while (std::getline(file, line)) {
-		std::istringstream ss(line);
-		std::string prefix;
-		ss >> prefix;
+	// Geometry shared through the mesh registry
+	const GpuMesh* mesh;
+	GLuint textureID;
 
-		if (prefix == "v") { // Vertex
-			glm::vec3 vertex;
-			ss >> vertex.x >> vertex.y >> vertex.z;
-			temp_vertices.push_back(vertex);
-		}
-		else if (prefix == "vt") { // Texture coordinate
-			glm::vec2 uv;
-			ss >> uv.x >> uv.y;
-			temp_uvs.push_back(uv);
-			hasUVs = true; // Set the flag since we found a vt line
-		}
-		else if (prefix == "f") { // Face
-			GLuint vertexIndex[3], uvIndex[3];
-			char separator;
-			std::string vertexData;
-
-			if (hasUVs) {
-				for (int i = 0; i < 3; ++i) {
-					ss >> vertexData;
-
-					// Parse the format v/vt//vn or v//vn
-					size_t firstSlash = vertexData.find('/');
-					size_t secondSlash = vertexData.find('/', firstSlash + 1);
-
-					if (secondSlash != std::string::npos) {
-						// v//vn or v/vt//vn format
-						vertexIndex[i] = std::stoi(vertexData.substr(0, firstSlash)) - 1;
-						uvIndex[i] = (secondSlash - firstSlash > 1) ? std::stoi(vertexData.substr(firstSlash + 1, secondSlash - firstSlash - 1)) - 1 : 0;
-					}
-					else {
-						// v/vt format
-						vertexIndex[i] = std::stoi(vertexData.substr(0, firstSlash)) - 1;
-						uvIndex[i] = std::stoi(vertexData.substr(firstSlash + 1)) - 1;
-					}
-
-					indices.push_back(vertexIndex[i]);
-				}
+	// Shader Variable IDs
+	GLuint modelMatrixID;
+	GLuint textureSamplerID;
+	GLuint programID;
 
-				for (int i = 0; i < 3; ++i) {
-					uvs.push_back(temp_uvs[uvIndex[i]].x);
-					uvs.push_back(temp_uvs[uvIndex[i]].y);
-				}
-			}
-			else {
-				for (int i = 0; i < 3; ++i) {
-					ss >> vertexData;
+	void initialize(glm::vec3 position, glm::vec3 scale, char* texturePath, const char* meshPath, const MeshData& meshData, const ImageData& image) {
+		this->position = position;
+		this->scale = scale;
+		this->texture = texturePath;
+		mesh = AcquireMesh(meshPath, IslandColors, &meshData);
 
-					// Parse the format v//vn
-					size_t firstSlash = vertexData.find('/');
+		// Load Texture
+		textureID = AcquireTexture(texturePath, terrainSampler, &image);
 
-					if (firstSlash != std::string::npos) {
-						vertexIndex[i] = std::stoi(vertexData.substr(0, firstSlash)) - 1;
-					}
-					else {
-						vertexIndex[i] = std::stoi(vertexData) - 1;
-					}
+		// Load Shaders
+		programID = AcquireProgram("../../../lab2/shaders/island.vert", "../../../lab2/shaders/island.frag"); // Assuming you have these shaders
+		modelMatrixID = glGetUniformLocation(programID, "model");
+		textureSamplerID = glGetUniformLocation(programID, "textureSampler");
+	}
 
-					indices.push_back(vertexIndex[i]);
-				}
+	void submit(RenderQueue& queue, glm::mat4 cameraMatrix) {
+		// Model matrix
+		glm::mat4 modelMatrix = glm::mat4(1.0f);
+		modelMatrix = glm::translate(modelMatrix, position);
+		modelMatrix = glm::scale(modelMatrix, scale);
 
-				for (int i = 0; i < 3; i++) {
-					uvs.push_back(0.0f);
-					uvs.push_back(0.0f);
-				}
-			}
-		}
+		DrawPacket packet;
+		packet.programID = programID;
+		packet.matrixLocation = modelMatrixID;
+		packet.samplerLocation = textureSamplerID;
+		packet.textureID = textureID;
+		packet.vertexArrayID = mesh->vertexArrayID;
+		packet.indexCount = mesh->indexCount;
+		packet.matrix = modelMatrix;
+
+		// Clip space w of the mesh centre is its view depth
+		glm::vec4 center = cameraMatrix * modelMatrix * glm::vec4((mesh->boundsMin + mesh->boundsMax) * 0.5f, 1.0f);
+		queue.submit(packet, RenderPassOpaque, center.w);
 	}
 
-	for (const auto& v : temp_vertices) {
-		vertices.push_back(v.x);
-		vertices.push_back(v.y);
-		vertices.push_back(v.z);
+	void cleanup() {
+		ReleaseMesh(mesh);
+		ReleaseTexture(textureID);
+		ReleaseProgram(programID);
 	}
-}
+};
+static void CloudColors(size_t vertexCount, GLfloat* colors) {
+	// Generate colors based on vertex index
+	for (size_t i = 0; i < vertexCount; ++i) {
+		colors[i * 3] = 0.8f + 0.2f * (static_cast<float>(i) / static_cast<float>(vertexCount)); // Red
+		colors[i * 3 + 1] = 0.8f + 0.2f * (static_cast<float>(i * i) / static_cast<float>(vertexCount * vertexCount)); // Green
+		colors[i * 3 + 2] = 0.8f + 0.2f * (static_cast<float>(i * i * i) / static_cast<float>(vertexCount * vertexCount * vertexCount)); // Blue
 
-static GLuint LoadTextureTileBox(const char *texture_file_path) {
-    int w, h, channels;
-    uint8_t* img = stbi_load(texture_file_path, &w, &h, &channels, 3);
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-	// Set texture wrapping parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	// Set texture filtering parameters
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    if (img) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, img);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cout << "Failed to load texture " << texture_file_path << std::endl;
-    }
-    stbi_image_free(img);
-
-    return texture;
+	}
 }
 
-struct Island {
-    glm::vec3 position;
-    glm::vec3 scale;
-    char* texture;
-	std::vector<GLfloat> vertices;
-	std::vector<GLfloat> uvs;
-	std::vector<GLuint> indices;
-    std::vector<GLfloat> colors; // Added color vector
-
-    // OpenGL Buffers
-    GLuint vertexArrayID;
-    GLuint vertexBufferID;
-	GLuint uvBufferID;
-    GLuint indexBufferID;
-	GLuint colorBufferID; // Added color buffer
-    GLuint textureID;
-
-    // Shader Variable IDs
-    GLuint mvpMatrixID;
-    GLuint textureSamplerID;
-    GLuint programID;
-
-    void initialize(glm::vec3 position, glm::vec3 scale, char* texturePath, const char* objPath) {
-        this->position = position;
-        this->scale = scale;
-        this->texture = texturePath;
-		betterLoader(objPath, vertices, uvs, indices);
-
-		colors.resize(vertices.size());
-		// Generate brownish colors with different lighting
-		for (size_t i = 0; i < vertices.size() / 3; ++i) {
-			float intensity = 0.5f + 0.5f * (static_cast<float>(i) / static_cast<float>(vertices.size() / 3)); // Vary intensity from 0.5 to 1.0
-			float red = 0.6f * intensity;   // Base red with intensity adjustment
-			float green = 0.4f * intensity; // Base green with intensity adjustment
-			float blue = 0.2f * intensity;  // Base blue with intensity adjustment (kept low for brown tone)
-
-			colors[i * 3] = red;   // Red
-			colors[i * 3 + 1] = green; // Green
-			colors[i * 3 + 2] = blue;  // Blue
-		}
-
-
-
-        // Create vertex array object
-        glGenVertexArrays(1, &vertexArrayID);
-        glBindVertexArray(vertexArrayID);
-
-        // Create vertex buffer object
-        glGenBuffers(1, &vertexBufferID);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
-
-		// Create color buffer object
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
-
-		// Create uv buffer object
-		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(GLfloat), uvs.data(), GL_STATIC_DRAW);
-
-        // Create index buffer object
-        glGenBuffers(1, &indexBufferID);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
-		
-        // Load Texture
-        textureID = LoadTextureTileBox(texturePath);
-
-
-        // Load Shaders
-        programID = LoadShadersFromFile("../../../lab2/shaders/island.vert", "../../../lab2/shaders/island.frag"); // Assuming you have these shaders
-        mvpMatrixID = glGetUniformLocation(programID, "MVP");
-        textureSamplerID = glGetUniformLocation(programID, "textureSampler");
-    }
-
-    void render(glm::mat4 cameraMatrix) {
-		glBindVertexArray(vertexArrayID);
-        glUseProgram(programID);
-
-        // Vertex attribute
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		
-		// Color attribute
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-		
-		// UV attribute
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-
-        // Index buffer
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-
-
-        // Model matrix
-        glm::mat4 modelMatrix = glm::mat4(1.0f);
-        modelMatrix = glm::translate(modelMatrix, position);
-        modelMatrix = glm::scale(modelMatrix, scale);
-
-        // MVP Matrix
-        glm::mat4 mvp = cameraMatrix * modelMatrix;
-        glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
-
-		// Texture
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glUniform1i(textureSamplerID, 0);
-
-        // Draw
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		
-        glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
-		glBindVertexArray(0);
-
-    }
-
-    void cleanup() {
-        glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &uvBufferID);
-        glDeleteBuffers(1, &indexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-        glDeleteVertexArrays(1, &vertexArrayID);
-        glDeleteTextures(1, &textureID);
-        glDeleteProgram(programID);
-    }
-};
 struct Cloud {
 	glm::vec3 position;
 	glm::vec3 scale;
 	char* texture;
-	std::vector<GLfloat> vertices;
-	std::vector<GLfloat> uvs;
-	std::vector<GLuint> indices;
-	std::vector<GLfloat> colors; // Added color vector
 
-	// OpenGL Buffers
-	GLuint vertexArrayID;
-	GLuint vertexBufferID;
-	GLuint uvBufferID;
-	GLuint indexBufferID;
-	GLuint colorBufferID; // Added color buffer
+	// Geometry shared through the mesh registry
+	const GpuMesh* mesh;
 	GLuint textureID;
 
 	// Shader Variable IDs
-	GLuint mvpMatrixID;
+	GLuint modelMatrixID;
 	GLuint textureSamplerID;
 	GLuint programID;
 
-	void initialize(glm::vec3 position, glm::vec3 scale, char* texturePath, const char* objPath) {
+	void initialize(glm::vec3 position, glm::vec3 scale, char* texturePath, const char* meshPath, const MeshData& meshData, const ImageData& image) {
 		this->position = position;
 		this->scale = scale;
 		this->texture = texturePath;
-		loadOBJfromTinkerCad(objPath, vertices, uvs, indices);
-
-		colors.resize(vertices.size());
-		// Generate colors based on vertex index
-		for (size_t i = 0; i < vertices.size() / 3; ++i) {
-			colors[i * 3] = 0.8f + 0.2f * (static_cast<float>(i) / static_cast<float>(vertices.size() / 3)); // Red
-			colors[i * 3 + 1] = 0.8f + 0.2f * (static_cast<float>(i * i) / static_cast<float>((vertices.size() / 3) * (vertices.size() / 3))); // Green
-			colors[i * 3 + 2] = 0.8f + 0.2f * (static_cast<float>(i * i * i) / static_cast<float>((vertices.size() / 3) * (vertices.size() / 3) * (vertices.size() / 3))); // Blue
-
-		}
-
-		// Create vertex array object
-		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
-
-		// Create vertex buffer object
-		glGenBuffers(1, &vertexBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
-
-		// Create color buffer object
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
-
-		// Create uv buffer object
-		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(GLfloat), uvs.data(), GL_STATIC_DRAW);
-
-		// Create index buffer object
-		glGenBuffers(1, &indexBufferID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+		mesh = AcquireMesh(meshPath, CloudColors, &meshData);
 
 		// Load Texture
-		textureID = LoadTextureTileBox(texturePath);
-
+		textureID = AcquireTexture(texturePath, terrainSampler, &image);
 
 		// Load Shaders
-		programID = LoadShadersFromFile("../../../lab2/shaders/island.vert", "../../../lab2/shaders/island.frag"); // Assuming you have these shaders
-		mvpMatrixID = glGetUniformLocation(programID, "MVP");
+		programID = AcquireProgram("../../../lab2/shaders/island.vert", "../../../lab2/shaders/island.frag"); // Assuming you have these shaders
+		modelMatrixID = glGetUniformLocation(programID, "model");
 		textureSamplerID = glGetUniformLocation(programID, "textureSampler");
 	}
 
-	void render(glm::mat4 cameraMatrix) {
-		glBindVertexArray(vertexArrayID);
+	void submit(RenderQueue& queue, glm::mat4 cameraMatrix) {
+		// Model matrix
+		glm::mat4 modelMatrix = glm::mat4(1.0f);
+		modelMatrix = glm::translate(modelMatrix, position);
+		modelMatrix = glm::scale(modelMatrix, scale);
 
-		glBindVertexArray(vertexArrayID);
-		glUseProgram(programID);
+		DrawPacket packet;
+		packet.programID = programID;
+		packet.matrixLocation = modelMatrixID;
+		packet.samplerLocation = textureSamplerID;
+		packet.textureID = textureID;
+		packet.vertexArrayID = mesh->vertexArrayID;
+		packet.indexCount = mesh->indexCount;
+		packet.matrix = modelMatrix;
+
+		// Clip space w of the mesh centre is its view depth
+		glm::vec4 center = cameraMatrix * modelMatrix * glm::vec4((mesh->boundsMin + mesh->boundsMax) * 0.5f, 1.0f);
+		queue.submit(packet, RenderPassOpaque, center.w);
+	}
 
-		// Vertex attribute
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	void cleanup() {
+		ReleaseMesh(mesh);
+		ReleaseTexture(textureID);
+		ReleaseProgram(programID);
+	}
+};
+static void TreeColors(size_t vertexCount, GLfloat* colors) {
+	// Generate colors based on vertex index
+	for (size_t i = 0; i < vertexCount; ++i) {
+		// Red: Minimal contribution, barely noticeable
+		colors[i * 3] = 0.05f + 0.05f * (static_cast<float>(i) / static_cast<float>(vertexCount));
 
-		// Color attribute
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		// Green: Dominant dark color, slightly varying
+		colors[i * 3 + 1] = 0.2f + 0.3f * (static_cast<float>(i) / static_cast<float>(vertexCount));
 
-		// UV attribute
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
+		// Blue: Minimal contribution, close to zero
+		colors[i * 3 + 2] = 0.02f + 0.03f * (static_cast<float>(i * i) / static_cast<float>(vertexCount * vertexCount));
+	}
+}
+
+struct Tree {
+	glm::vec3 position;
+	glm::vec3 scale;
+	char* texture;
+
+	// Geometry shared through the mesh registry
+	const GpuMesh* mesh;
+	GLuint textureID;
 
+	// Shader Variable IDs
+	GLuint modelMatrixID;
+	GLuint textureSamplerID;
+	GLuint programID;
 
-		// Index buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+	void initialize(glm::vec3 position, glm::vec3 scale, const char* meshPath, const MeshData& meshData) {
+		this->position = position;
+		this->scale = scale;
+		textureID = 0;
+		mesh = AcquireMesh(meshPath, TreeColors, &meshData);
 
+		// Load Shaders
+		programID = AcquireProgram("../../../lab2/shaders/island.vert", "../../../lab2/shaders/island.frag"); // Assuming you have these shaders
+		modelMatrixID = glGetUniformLocation(programID, "model");
+		textureSamplerID = glGetUniformLocation(programID, "textureSampler");
+	}
 
+	void submit(RenderQueue& queue, glm::mat4 cameraMatrix) {
 		// Model matrix
 		glm::mat4 modelMatrix = glm::mat4(1.0f);
 		modelMatrix = glm::translate(modelMatrix, position);
 		modelMatrix = glm::scale(modelMatrix, scale);
 
-		// MVP Matrix
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
-
-		// Texture
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glUniform1i(textureSamplerID, 0);
-
-		// Draw
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
-		glBindVertexArray(0);
+		DrawPacket packet;
+		packet.programID = programID;
+		packet.matrixLocation = modelMatrixID;
+		packet.samplerLocation = textureSamplerID;
+		packet.textureID = textureID;
+		packet.vertexArrayID = mesh->vertexArrayID;
+		packet.indexCount = mesh->indexCount;
+		packet.matrix = modelMatrix;
+
+		// Clip space w of the mesh centre is its view depth
+		glm::vec4 center = cameraMatrix * modelMatrix * glm::vec4((mesh->boundsMin + mesh->boundsMax) * 0.5f, 1.0f);
+		queue.submit(packet, RenderPassOpaque, center.w);
 	}
 
 	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &uvBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
-		glDeleteTextures(1, &textureID);
-		glDeleteProgram(programID);
+		ReleaseMesh(mesh);
+		ReleaseTexture(textureID);
+		ReleaseProgram(programID);
 	}
 };
-struct Tree {
+// The rock mesh is shared by every tile, so its colors are seeded per asset
+static const unsigned long long rockColorSeed = 0x526F636BULL;
+
+static void RockColors(size_t vertexCount, GLfloat* colors) {
+	// Generate dark gray colors based on vertex index
+	for (size_t i = 0; i < vertexCount; ++i) {
+		// Same gray for a vertex on every run and thread
+		float randomGray = 0.2f + 0.4f * CounterRandomUnit(rockColorSeed, i); // Random dark gray
+		colors[i * 3] = randomGray;   // Red
+		colors[i * 3 + 1] = randomGray; // Green
+		colors[i * 3 + 2] = randomGray; // Blue
+	}
+}
+
+struct Rock {
 	glm::vec3 position;
 	glm::vec3 scale;
 	char* texture;
-	std::vector<GLfloat> vertices;
-	std::vector<GLfloat> uvs;
-	std::vector<GLuint> indices;
-	std::vector<GLfloat> colors; // Added color vector
 
-	// OpenGL Buffers
-	GLuint vertexArrayID;
-	GLuint vertexBufferID;
-	GLuint uvBufferID;
-	GLuint indexBufferID;
-	GLuint colorBufferID; // Added color buffer
+	// Geometry shared through the mesh registry
+	const GpuMesh* mesh;
 	GLuint textureID;
 
 	// Shader Variable IDs
-	GLuint mvpMatrixID;
+	GLuint modelMatrixID;
 	GLuint textureSamplerID;
 	GLuint programID;
 
-	void initialize(glm::vec3 position, glm::vec3 scale, const char* objPath) {
+	void initialize(glm::vec3 position, glm::vec3 scale, const char* meshPath, const MeshData& meshData) {
 		this->position = position;
 		this->scale = scale;
-		loadOBJfromTinkerCad(objPath, vertices, uvs, indices);
-
-		colors.resize(vertices.size());
-		// Generate colors based on vertex index
-		for (size_t i = 0; i < vertices.size() / 3; ++i) {
-			// Red: Minimal contribution, barely noticeable
-			colors[i * 3] = 0.05f + 0.05f * (static_cast<float>(i) / static_cast<float>(vertices.size() / 3));
-
-			// Green: Dominant dark color, slightly varying
-			colors[i * 3 + 1] = 0.2f + 0.3f * (static_cast<float>(i) / static_cast<float>(vertices.size() / 3));
-
-			// Blue: Minimal contribution, close to zero
-			colors[i * 3 + 2] = 0.02f + 0.03f * (static_cast<float>(i * i) / static_cast<float>((vertices.size() / 3) * (vertices.size() / 3)));
-		}
-
-
-		// Create vertex array object
-		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
-
-		// Create vertex buffer object
-		glGenBuffers(1, &vertexBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
-
-		// Create color buffer object
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
-
-		// Create uv buffer object
-		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(GLfloat), uvs.data(), GL_STATIC_DRAW);
-
-		// Create index buffer object
-		glGenBuffers(1, &indexBufferID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
-
-		// Load Texture
-
-
-		// Load Shaders
-		programID = LoadShadersFromFile("../../../lab2/shaders/island.vert", "../../../lab2/shaders/island.frag"); // Assuming you have these shaders
-		mvpMatrixID = glGetUniformLocation(programID, "MVP");
-	}
-
-	void render(glm::mat4 cameraMatrix) {
-		glBindVertexArray(vertexArrayID);
-		glUseProgram(programID);
-
-		// Vertex attribute
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		// Color attribute
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		// UV attribute
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-
-		// Index buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-
-
-		// Model matrix
-		glm::mat4 modelMatrix = glm::mat4(1.0f);
-		modelMatrix = glm::translate(modelMatrix, position);
-		modelMatrix = glm::scale(modelMatrix, scale);
-
-		// MVP Matrix
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
-
-		// Texture
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glUniform1i(textureSamplerID, 0);
-
-		// Draw
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
-		glBindVertexArray(0);
-
-	}
-
-	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &uvBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
-		glDeleteTextures(1, &textureID);
-		glDeleteProgram(programID);
-	}
-};
-struct Rock {
-	glm::vec3 position;
-	glm::vec3 scale;
-	char* texture;
-	std::vector<GLfloat> vertices;
-	std::vector<GLfloat> uvs;
-	std::vector<GLuint> indices;
-	std::vector<GLfloat> colors; // Added color vector
-
-	// OpenGL Buffers
-	GLuint vertexArrayID;
-	GLuint vertexBufferID;
-	GLuint uvBufferID;
-	GLuint indexBufferID;
-	GLuint colorBufferID; // Added color buffer
-	GLuint textureID;
-
-	// Shader Variable IDs
-	GLuint mvpMatrixID;
-	GLuint textureSamplerID;
-	GLuint programID;
-
-	void initialize(glm::vec3 position, glm::vec3 scale, const char* objPath) {
-		this->position = position;
-		this->scale = scale;
-		loadOBJfromTinkerCad(objPath, vertices, uvs, indices);
-
-		colors.resize(vertices.size());
-		// Generate dark gray colors based on vertex index
-		for (size_t i = 0; i < vertices.size() / 3; ++i) {
-			// Randomized single color per face
-			float randomGray = 0.2f + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / 0.4f)); // Random dark gray
-			colors[i * 3] = randomGray;   // Red
-			colors[i * 3 + 1] = randomGray; // Green
-			colors[i * 3 + 2] = randomGray; // Blue
-		}
-
-
-
-		// Create vertex array object
-		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
-
-		// Create vertex buffer object
-		glGenBuffers(1, &vertexBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
-
-		// Create color buffer object
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
-
-		// Create uv buffer object
-		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(GLfloat), uvs.data(), GL_STATIC_DRAW);
-
-		// Create index buffer object
-		glGenBuffers(1, &indexBufferID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
-
-		// Load Texture
-
-
-		// Load Shaders
-		programID = LoadShadersFromFile("../../../lab2/shaders/island.vert", "../../../lab2/shaders/island.frag"); // Assuming you have these shaders
-		mvpMatrixID = glGetUniformLocation(programID, "MVP");
-	}
-
-	void render(glm::mat4 cameraMatrix) {
-		glBindVertexArray(vertexArrayID);
-		glUseProgram(programID);
-
-		// Vertex attribute
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		// Color attribute
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		// UV attribute
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-
-		// Index buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+		textureID = 0;
+		mesh = AcquireMesh(meshPath, RockColors, &meshData);
 
+		// Load Shaders
+		programID = AcquireProgram("../../../lab2/shaders/island.vert", "../../../lab2/shaders/island.frag"); // Assuming you have these shaders
+		modelMatrixID = glGetUniformLocation(programID, "model");
+		textureSamplerID = glGetUniformLocation(programID, "textureSampler");
+	}
 
+	void submit(RenderQueue& queue, glm::mat4 cameraMatrix) {
 		// Model matrix
 		glm::mat4 modelMatrix = glm::mat4(1.0f);
 		modelMatrix = glm::translate(modelMatrix, position);
 		modelMatrix = glm::scale(modelMatrix, scale);
 
-		// MVP Matrix
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
-
-		// Texture
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glUniform1i(textureSamplerID, 0);
-
-		// Draw
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
-		glBindVertexArray(0);
+		DrawPacket packet;
+		packet.programID = programID;
+		packet.matrixLocation = modelMatrixID;
+		packet.samplerLocation = textureSamplerID;
+		packet.textureID = textureID;
+		packet.vertexArrayID = mesh->vertexArrayID;
+		packet.indexCount = mesh->indexCount;
+		packet.matrix = modelMatrix;
+
+		// Clip space w of the mesh centre is its view depth
+		glm::vec4 center = cameraMatrix * modelMatrix * glm::vec4((mesh->boundsMin + mesh->boundsMax) * 0.5f, 1.0f);
+		queue.submit(packet, RenderPassOpaque, center.w);
 	}
 
 	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &uvBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
-		glDeleteTextures(1, &textureID);
-		glDeleteProgram(programID);
+		ReleaseMesh(mesh);
+		ReleaseTexture(textureID);
+		ReleaseProgram(programID);
 	}
 };
 struct skyBox {
@@ -1482,7 +766,7 @@ struct skyBox {
 	GLuint textureID;
 
 	// Shader variable IDs
-	GLuint mvpMatrixID;
+	GLuint modelMatrixID;
 	GLuint textureSamplerID;
 	GLuint programID;
 
@@ -1496,18 +780,22 @@ struct skyBox {
 
 		// Create a vertex array object
 		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
+		CachedBindVertexArray(vertexArrayID);
 
 		// Create a vertex buffer object to store the vertex data
 		glGenBuffers(1, &vertexBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+		CachedBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data), vertex_buffer_data, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
 		// Create a vertex buffer object to store the color data
         // TODO:
 		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
+		CachedBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(color_buffer_data), color_buffer_data, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
 		// TODO: Create a vertex buffer object to store the UV data
 		// --------------------------------------------------------
@@ -1515,23 +803,29 @@ struct skyBox {
 		for (int i = 0; i < 24; ++i) uv_buffer_data[2*i+1] *= height; //In this loop, the texture coordinates at odd indices (xyz --> y) are scaled by a factor of 5.
 
 		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
+		CachedBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(uv_buffer_data), uv_buffer_data,
 GL_STATIC_DRAW);
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
+
 		// Create an index buffer object to store the index data that defines triangle faces
 		glGenBuffers(1, &indexBufferID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+		CachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index_buffer_data), index_buffer_data, GL_STATIC_DRAW);
 
+		// The VAO now holds the attribute layout, render() only binds it
+		CachedBindVertexArray(0);
+
 		// Create and compile our GLSL program from the shaders
-		programID = LoadShadersFromFile("../../../lab2/shaders/skybox.vert", "../../../lab2/shaders/skybox.frag");
+		programID = AcquireProgram("../../../lab2/shaders/skybox.vert", "../../../lab2/shaders/skybox.frag");
 		if (programID == 0)
 		{
 			std::cerr << "Failed to load shaders." << std::endl;
 		}
 
-		// Get a handle for our "MVP" uniform
-		mvpMatrixID = glGetUniformLocation(programID, "MVP");
+		// Get a handle for our "model" uniform
+		modelMatrixID = glGetUniformLocation(programID, "model");
 
         // TODO: Load a texture
         // --------------------
@@ -1545,28 +839,13 @@ GL_STATIC_DRAW);
 
 	}
 
-	void render(glm::mat4 cameraMatrix) {
-		glBindVertexArray(vertexArrayID);
-		glUseProgram(programID);
-
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+	// The shader removes the camera translation itself
+	void render() {
+		CachedBindVertexArray(vertexArrayID);
+		CachedUseProgram(programID);
 
 		// TODO: Model transform
 		// -----------------------
-
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
         glm::mat4 modelMatrix = glm::mat4();
         // Scale the box along each axis to make it look like a building
         modelMatrix = glm::scale(modelMatrix, scale);
@@ -1574,20 +853,10 @@ GL_STATIC_DRAW);
 
         // -----------------------
 
-		// Set model-view-projection matrix
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
+		// Set model matrix, view and projection are in FrameConstants
+		glUniformMatrix4fv(modelMatrixID, 1, GL_FALSE, &modelMatrix[0][0]);
 
-		// TODO: Enable UV buffer and texture sampler
-		// ------------------------------------------
-        // ------------------------------------------
-
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		CachedBindTexture(0, GL_TEXTURE_2D, textureID);
 		glUniform1i(textureSamplerID, 0);
 
 		// Draw the box
@@ -1597,474 +866,368 @@ GL_STATIC_DRAW);
 			GL_UNSIGNED_INT,   // type
 			(void*)0           // element array buffer offset
 		);
-
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-        //glDisableVertexAttribArray(2);
-		glBindVertexArray(0);
-
 	}
 
 	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
-		//glDeleteBuffers(1, &uvBufferID);
-		//glDeleteTextures(1, &textureID);
-		glDeleteProgram(programID);
+		CachedDeleteBuffer(vertexBufferID);
+		CachedDeleteBuffer(colorBufferID);
+		CachedDeleteBuffer(indexBufferID);
+		CachedDeleteVertexArray(vertexArrayID);
+		//CachedDeleteBuffer(uvBufferID);
+		//CachedDeleteTexture(textureID);
+		ReleaseProgram(programID);
 	}
 };
 
+static void SurfaceColors(size_t vertexCount, GLfloat* colors) {
+	// Generate colors based on vertex index
+	for (size_t i = 0; i < vertexCount; ++i) {
+		colors[i * 3] = 0.4f + 0.2f * (static_cast<float>(i) / static_cast<float>(vertexCount)); // Red (lower base value)
+		colors[i * 3 + 1] = 0.8f + 0.2f * (static_cast<float>(i * i) / static_cast<float>(vertexCount * vertexCount)); // Green (higher base value, prioritized)
+		colors[i * 3 + 2] = 0.3f + 0.1f * (static_cast<float>(i * i * i) / static_cast<float>(vertexCount * vertexCount * vertexCount)); // Blue (minimal)
+	}
+}
+
 struct Surface {
 	glm::vec3 position;
 	glm::vec3 scale;
 	char* texture;
-	std::vector<GLfloat> vertices;
-	std::vector<GLfloat> uvs;
-	std::vector<GLuint> indices;
-	std::vector<GLfloat> colors; // Added color vector
 
-	// OpenGL Buffers
-	GLuint vertexArrayID;
-	GLuint vertexBufferID;
-	GLuint uvBufferID;
-	GLuint indexBufferID;
-	GLuint colorBufferID; // Added color buffer
+	// Geometry shared through the mesh registry
+	const GpuMesh* mesh;
 	GLuint textureID;
 
 	// Shader Variable IDs
-	GLuint mvpMatrixID;
+	GLuint modelMatrixID;
 	GLuint textureSamplerID;
 	GLuint programID;
 
-	void initialize(glm::vec3 position, glm::vec3 scale, char* texturePath, const char* objPath) {
+	void initialize(glm::vec3 position, glm::vec3 scale, char* texturePath, const char* meshPath, const MeshData& meshData, const ImageData& image) {
 		this->position = position;
 		this->scale = scale;
 		this->texture = texturePath;
-		betterLoader(objPath, vertices, uvs, indices);
-
-		colors.resize(vertices.size());
-		// Generate colors based on vertex index
-		for (size_t i = 0; i < vertices.size() / 3; ++i) {
-			colors[i * 3] = 0.4f + 0.2f * (static_cast<float>(i) / static_cast<float>(vertices.size() / 3)); // Red (lower base value)
-			colors[i * 3 + 1] = 0.8f + 0.2f * (static_cast<float>(i * i) / static_cast<float>((vertices.size() / 3) * (vertices.size() / 3))); // Green (higher base value, prioritized)
-			colors[i * 3 + 2] = 0.3f + 0.1f * (static_cast<float>(i * i * i) / static_cast<float>((vertices.size() / 3) * (vertices.size() / 3) * (vertices.size() / 3))); // Blue (minimal)
-		}
-
-
-		// Create vertex array object
-		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
-
-		// Create vertex buffer object
-		glGenBuffers(1, &vertexBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
-
-		// Create color buffer object
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(GLfloat), colors.data(), GL_STATIC_DRAW);
-
-		// Create uv buffer object
-		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(GLfloat), uvs.data(), GL_STATIC_DRAW);
-
-		// Create index buffer object
-		glGenBuffers(1, &indexBufferID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+		mesh = AcquireMesh(meshPath, SurfaceColors, &meshData);
 
 		// Load Texture
-		textureID = LoadTextureTileBox(texturePath);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // Changed to NEAREST
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST); // Changed to NEAREST
+		textureID = AcquireTexture(texturePath, surfaceSampler, &image); // NEAREST filtering
 
 		// Load Shaders
-		programID = LoadShadersFromFile("../../../lab2/shaders/island.vert", "../../../lab2/shaders/island.frag"); // Assuming you have these shaders
-		mvpMatrixID = glGetUniformLocation(programID, "MVP");
+		programID = AcquireProgram("../../../lab2/shaders/island.vert", "../../../lab2/shaders/island.frag"); // Assuming you have these shaders
+		modelMatrixID = glGetUniformLocation(programID, "model");
 		textureSamplerID = glGetUniformLocation(programID, "textureSampler");
 	}
 
-	void render(glm::mat4 cameraMatrix) {
-		glBindVertexArray(vertexArrayID);
-		glUseProgram(programID);
-
-		// Vertex attribute
-		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		// Color attribute
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		// UV attribute
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-
-
-		// Index buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-
-
+	void submit(RenderQueue& queue, glm::mat4 cameraMatrix) {
 		// Model matrix
 		glm::mat4 modelMatrix = glm::mat4(1.0f);
 		modelMatrix = glm::translate(modelMatrix, position);
 		modelMatrix = glm::scale(modelMatrix, scale);
 
-		// MVP Matrix
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
-
-		// Texture
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glUniform1i(textureSamplerID, 0);
-
-		// Draw
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
-		glBindVertexArray(0);
+		DrawPacket packet;
+		packet.programID = programID;
+		packet.matrixLocation = modelMatrixID;
+		packet.samplerLocation = textureSamplerID;
+		packet.textureID = textureID;
+		packet.vertexArrayID = mesh->vertexArrayID;
+		packet.indexCount = mesh->indexCount;
+		packet.matrix = modelMatrix;
+
+		// Clip space w of the mesh centre is its view depth
+		glm::vec4 center = cameraMatrix * modelMatrix * glm::vec4((mesh->boundsMin + mesh->boundsMax) * 0.5f, 1.0f);
+		queue.submit(packet, RenderPassOpaque, center.w);
 	}
 
 	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &uvBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
-		glDeleteTextures(1, &textureID);
-		glDeleteProgram(programID);
+		ReleaseMesh(mesh);
+		ReleaseTexture(textureID);
+		ReleaseProgram(programID);
 	}
 };
 
-struct Building {
-	glm::vec3 position;		// Position of the box 
-	glm::vec3 scale;		// Size of the box in each axis
-	glm::vec3 rotation;   // Initial rotation (in degrees) around X, Y, Z axes
-
-	char* texture;
-	int height;
-	GLfloat vertex_buffer_data[72] = {	// Vertex definition for a canonical box
-		// Front face
-		-1.0f, -1.0f, 1.0f,
-		1.0f, -1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		-1.0f, 1.0f, 1.0f,
-
-		// Back face 
-		1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f, -1.0f,
-		-1.0f, 1.0f, -1.0f,
-		1.0f, 1.0f, -1.0f,
-
-		// Left face
-		-1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f, 1.0f,
-		-1.0f, 1.0f, 1.0f,
-		-1.0f, 1.0f, -1.0f,
-
-		// Right face 
-		1.0f, -1.0f, 1.0f,
-		1.0f, -1.0f, -1.0f,
-		1.0f, 1.0f, -1.0f,
-		1.0f, 1.0f, 1.0f,
+// Canonical box shared by every building instance
+static const GLfloat buildingVertexData[72] = {
+	// Front face
+	-1.0f, -1.0f, 1.0f,
+	1.0f, -1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	-1.0f, 1.0f, 1.0f,
+
+	// Back face 
+	1.0f, -1.0f, -1.0f,
+	-1.0f, -1.0f, -1.0f,
+	-1.0f, 1.0f, -1.0f,
+	1.0f, 1.0f, -1.0f,
+
+	// Left face
+	-1.0f, -1.0f, -1.0f,
+	-1.0f, -1.0f, 1.0f,
+	-1.0f, 1.0f, 1.0f,
+	-1.0f, 1.0f, -1.0f,
+
+	// Right face 
+	1.0f, -1.0f, 1.0f,
+	1.0f, -1.0f, -1.0f,
+	1.0f, 1.0f, -1.0f,
+	1.0f, 1.0f, 1.0f,
+
+	// Top face
+	-1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, 1.0f,
+	1.0f, 1.0f, -1.0f,
+	-1.0f, 1.0f, -1.0f,
+
+	// Bottom face
+	-1.0f, -1.0f, -1.0f,
+	1.0f, -1.0f, -1.0f,
+	1.0f, -1.0f, 1.0f,
+	-1.0f, -1.0f, 1.0f,
+};
 
-		// Top face
-		-1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, 1.0f,
-		1.0f, 1.0f, -1.0f,
-		-1.0f, 1.0f, -1.0f,
+static const GLuint buildingIndexData[36] = {		// 12 triangle faces of a box
+	0, 1, 2,
+	0, 2, 3,
 
-		// Bottom face
-		-1.0f, -1.0f, -1.0f,
-		1.0f, -1.0f, -1.0f,
-		1.0f, -1.0f, 1.0f,
-		-1.0f, -1.0f, 1.0f,
-	};
+	4, 5, 6,
+	4, 6, 7,
 
+	8, 9, 10,
+	8, 10, 11,
 
-	GLfloat color_buffer_data[72] =
+	12, 13, 14,
+	12, 14, 15,
 
-	{
-		// Front, red
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-
-		// Back, yellow
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
+	16, 17, 18,
+	16, 18, 19,
 
-		// Left, green
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		// Right, cyan
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
+	20, 21, 22,
+	20, 22, 23,
+};
 
-		// Top, blue
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
+// horizontal vertical
+static const GLfloat buildingUVData[48] = {
+	// Front
+	0.0f, 1.0f,
+	0.5f, 1.0f,
+	0.5f, 0.0f,
+	0.0f, 0.0f,
+	// Back
+	0.0f, 1.0f,
+	0.5f, 1.0f,
+	0.5f, 0.0f,
+	0.0f, 0.0f,
+
+	// Left
+	0.0f, 1.0f,
+	0.5f, 1.0f,
+	0.5f, 0.0f,
+	0.0f, 0.0f,
+
+	// Right
+	0.0f, 1.0f,
+	0.5f, 1.0f,
+	0.5f, 0.0f,
+	0.0f, 0.0f,
+
+	// Top - we do not want texture the top
+	1.0f, 1.0f,
+	0.5f, 1.0f,
+	0.5f, 0.0f,
+	1.0f, 0.0f,
+
+	// Bottom - we do not want texture the bottom
+	0.0f, 0.0f,
+	0.0f, 0.0f,
+	0.0f, 0.0f,
+	0.0f, 0.0f,
+};
 
-		// Bottom, magenta
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
+// All buildings of a tile, drawn with a single instanced call. The cube
+// buffers are shared by every batch; each batch only owns its VAO and the
+// per-instance model matrices and facade layers.
+struct BuildingBatch {
+	struct Instance {
+		glm::mat4 model;
+		GLfloat facade;		// Layer in the facade texture array
 	};
 
-	GLuint index_buffer_data[36] = {		// 12 triangle faces of a box
-		0, 1, 2,
-		0, 2, 3,
-
-		4, 5, 6,
-		4, 6, 7,
+	// Shared cube geometry
+	static GLuint vertexBufferID;
+	static GLuint uvBufferID;
+	static GLuint indexBufferID;
+	static int cubeRefCount;
 
-		8, 9, 10,
-		8, 10, 11,
-
-		12, 13, 14,
-		12, 14, 15,
-
-		16, 17, 18,
-		16, 18, 19,
-
-		20, 21, 22,
-		20, 22, 23,
-	};
-
-	// TODO: Define UV buffer data
-	// ---------------------------
-	// ---------------------------horizontal vertical
-	GLfloat uv_buffer_data[48] = {
-		// Front
-		0.0f, 1.0f,
-		0.5f, 1.0f,
-		0.5f, 0.0f,
-		0.0f, 0.0f,
-		// Back
-		0.0f, 1.0f,
-		0.5f, 1.0f,
-		0.5f, 0.0f,
-		0.0f, 0.0f,
-
-		// Left
-		0.0f, 1.0f,
-		0.5f, 1.0f,
-		0.5f, 0.0f,
-		0.0f, 0.0f,
-
-		// Right
-		0.0f, 1.0f,
-		0.5f, 1.0f,
-		0.5f, 0.0f,
-		0.0f, 0.0f,
-
-		// Top - we do not want texture the top
-		1.0f, 1.0f,
-		0.5f, 1.0f,
-		0.5f, 0.0f,
-		1.0f, 0.0f,
-
-		// Bottom - we do not want texture the bottom
-		0.0f, 0.0f,
-		0.0f, 0.0f,
-		0.0f, 0.0f,
-		0.0f, 0.0f,
-	};
 	// OpenGL buffers
 	GLuint vertexArrayID;
-	GLuint vertexBufferID;
-	GLuint indexBufferID;
-	GLuint colorBufferID;
-	GLuint uvBufferID;
+	GLuint instanceBufferID;
 	GLuint textureID;
+	GLsizei instanceCount;
+
+	// CPU copy of every instance; only the visible ones are in the buffer
+	std::vector<Instance> instances;
+	std::vector<Instance> visibleInstances;
+	std::vector<unsigned char> uploadedVisible;
 
 	// Shader variable IDs
-	GLuint mvpMatrixID;
 	GLuint textureSamplerID;
 	GLuint programID;
 
-	void initialize(glm::vec3 position, glm::vec3 scale, char* texture, int height, glm::vec3 rotation = glm::vec3(0.0f)) {
-		// Define scale of the building geometry
-		this->position = position;
-		this->scale = scale;
-		this->texture = texture;
-		this->height = height;
-		this->rotation = rotation;
-
-		for (int i = 0; i < 72; ++i) color_buffer_data[i] = 1.0f;
-
-		// Create a vertex array object
-		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
+	static void acquireCube() {
+		if (cubeRefCount++ > 0) {
+			return;
+		}
+		// The index buffer binding would land in whatever VAO is bound
+		CachedBindVertexArray(0);
 
-		// Create a vertex buffer object to store the vertex data		
 		glGenBuffers(1, &vertexBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data), vertex_buffer_data, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the color data
-		// TODO: 
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(color_buffer_data), color_buffer_data, GL_STATIC_DRAW);
-
-		// TODO: Create a vertex buffer object to store the UV data
-		// --------------------------------------------------------
-		// --------------------------------------------------------
+		CachedBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(buildingVertexData), buildingVertexData, GL_STATIC_DRAW);
 
 		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(uv_buffer_data), uv_buffer_data,
-			GL_STATIC_DRAW);
-		// Create an index buffer object to store the index data that defines triangle faces
+		CachedBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(buildingUVData), buildingUVData, GL_STATIC_DRAW);
+
 		glGenBuffers(1, &indexBufferID);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index_buffer_data), index_buffer_data, GL_STATIC_DRAW);
+		CachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(buildingIndexData), buildingIndexData, GL_STATIC_DRAW);
+	}
 
-		// Create and compile our GLSL program from the shaders
-		programID = LoadShadersFromFile("../../../lab2/shaders/box.vert", "../../../lab2/shaders/box.frag");
-		if (programID == 0)
-		{
-			std::cerr << "Failed to load shaders." << std::endl;
+	static void releaseCube() {
+		if (--cubeRefCount > 0) {
+			return;
 		}
-		mvpMatrixID = glGetUniformLocation(programID, "MVP");
-		textureID = LoadTextureTileBox(texture);
-		textureSamplerID = glGetUniformLocation(programID, "textureSampler");
-		// Bind the texture
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// Set texture wrapping parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT); // Wrap texture horizontally (U axis)
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT); // Wrap texture vertically (V axis)
-
-		// Set texture filtering parameters
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // Minification filter
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // Magnification filter
-
-		// Unbind the texture
-		// Assuming you have a valid OpenGL context and a texture ID
-		GLuint textureID;
-		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-
-		// Set texture wrapping parameters to remove seams
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-		// Set texture filtering parameters to ensure smooth transitions
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// Generate mipmaps for the texture
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		// Unbind the texture
-		glBindTexture(GL_TEXTURE_2D, 0);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		CachedDeleteBuffer(vertexBufferID);
+		CachedDeleteBuffer(uvBufferID);
+		CachedDeleteBuffer(indexBufferID);
 	}
 
-	void render(glm::mat4 cameraMatrix) {
-		glBindVertexArray(vertexArrayID);
+	void initialize(const std::vector<BuildingDesc>& buildings, const std::string* facadePaths, const ImageData* facades) {
+		// Model matrices are fixed, so compute them once here instead of every frame
+		instances.resize(buildings.size());
+		for (size_t i = 0; i < buildings.size(); ++i) {
+			const BuildingDesc& desc = buildings[i];
+			glm::mat4 modelMatrix = glm::mat4();
+			modelMatrix = glm::translate(modelMatrix, desc.position);
+			modelMatrix = glm::rotate(modelMatrix, glm::radians(desc.rotation.x), glm::vec3(1.0f, 0.0f, 0.0f)); // X-axis rotation
+			modelMatrix = glm::rotate(modelMatrix, glm::radians(desc.rotation.y), glm::vec3(0.0f, 1.0f, 0.0f)); // Y-axis rotation
+			modelMatrix = glm::rotate(modelMatrix, glm::radians(desc.rotation.z), glm::vec3(0.0f, 0.0f, 1.0f)); // Z-axis rotation
+			modelMatrix = glm::scale(modelMatrix, desc.scale);
+			instances[i].model = modelMatrix;
+			instances[i].facade = static_cast<GLfloat>(desc.facade);
+		}
+		instanceCount = static_cast<GLsizei>(instances.size());
+		uploadedVisible.assign(instances.size(), 1);
+
+		acquireCube();
 
-		glUseProgram(programID);
+		// The VAO captures the attribute layout once, render() only binds it
+		glGenVertexArrays(1, &vertexArrayID);
+		CachedBindVertexArray(vertexArrayID);
 
 		glEnableVertexAttribArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+		CachedBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
 
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-
-		// TODO: Model transform 
-		// -----------------------
-
 		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
+		CachedBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
-		glm::mat4 modelMatrix = glm::mat4();
-		// Scale the box along each axis to make it look like a building
-		modelMatrix = glm::translate(modelMatrix, position);
-		modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f)); // X-axis rotation
-		modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f)); // Y-axis rotation
-		modelMatrix = glm::rotate(modelMatrix, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f)); // Z-axis rotation
-		modelMatrix = glm::scale(modelMatrix, scale);
 
-		// -----------------------
+		CachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+
+		// Per-instance model matrix (locations 3-6) and facade layer (location 7)
+		glGenBuffers(1, &instanceBufferID);
+		CachedBindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+		glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_DYNAMIC_DRAW);
+		NoteUploadBytes(instances.size() * sizeof(Instance));
+		for (int column = 0; column < 4; ++column) {
+			glEnableVertexAttribArray(3 + column);
+			glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), BUFFER_OFFSET(column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(3 + column, 1);
+		}
+		glEnableVertexAttribArray(7);
+		glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), BUFFER_OFFSET(sizeof(glm::mat4)));
+		glVertexAttribDivisor(7, 1);
 
-		// Set model-view-projection matrix
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
+		CachedBindVertexArray(0);
+
+		// Create and compile our GLSL program from the shaders
+		programID = AcquireProgram("../../../lab2/shaders/box_instanced.vert", "../../../lab2/shaders/box_instanced.frag");
+		if (programID == 0)
+		{
+			std::cerr << "Failed to load shaders." << std::endl;
+		}
+		textureSamplerID = glGetUniformLocation(programID, "textureSampler");
 
-		// TODO: Enable UV buffer and texture sampler
-		// ------------------------------------------
-		// ------------------------------------------
+		// All four facades as layers of one texture, repeat wrapping with linear filtering
+		const char* paths[4];
+		for (int i = 0; i < 4; ++i) {
+			paths[i] = facadePaths[i].c_str();
+		}
+		textureID = AcquireTextureArray(paths, 4, buildingSampler, facades);
+	}
 
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	// Instance data on the GPU and CPU
+	size_t memoryBytes() const {
+		return sizeof(Instance) * (2 * instances.size() + visibleInstances.capacity()) + uploadedVisible.capacity();
+	}
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glUniform1i(textureSamplerID, 0);
+	// World-space box of every building, in instance order
+	void addBounds(BoundsList& bounds) const {
+		for (size_t i = 0; i < instances.size(); ++i) {
+			glm::vec3 center, extent;
+			TransformBounds(instances[i].model, glm::vec3(-1.0f), glm::vec3(1.0f), center, extent);
+			bounds.add(center, extent);
+		}
+	}
 
-		// Draw the box
-		glDrawElements(
-			GL_TRIANGLES,      // mode
-			36,    			   // number of indices
-			GL_UNSIGNED_INT,   // type
-			(void*)0           // element array buffer offset
-		);
+	// visible holds one flag per instance, from CullBounds
+	void submit(RenderQueue& queue, const unsigned char* visible, float depth) {
+		// Re-upload only when the visible set changed since the last frame
+		if (!std::equal(uploadedVisible.begin(), uploadedVisible.end(), visible)) {
+			visibleInstances.clear();
+			for (size_t i = 0; i < instances.size(); ++i) {
+				if (visible[i]) {
+					visibleInstances.push_back(instances[i]);
+				}
+			}
+			uploadedVisible.assign(visible, visible + instances.size());
+			instanceCount = static_cast<GLsizei>(visibleInstances.size());
+			if (instanceCount > 0) {
+				CachedBindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, visibleInstances.size() * sizeof(Instance), visibleInstances.data());
+			}
+		}
+		if (instanceCount == 0) {
+			return;
+		}
 
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		//glDisableVertexAttribArray(2);
-		glBindVertexArray(0);
+		// Draw every visible box of the tile
+		DrawPacket packet;
+		packet.programID = programID;
+		packet.samplerLocation = textureSamplerID;
+		packet.textureTarget = GL_TEXTURE_2D_ARRAY;
+		packet.textureID = textureID;
+		packet.vertexArrayID = vertexArrayID;
+		packet.indexCount = 36;
+		packet.instanceCount = instanceCount;
+		queue.submit(packet, RenderPassOpaque, depth);
 	}
 
 	void cleanup() {
-		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
-		glDeleteBuffers(1, &indexBufferID);
-		glDeleteVertexArrays(1, &vertexArrayID);
-		glDeleteBuffers(1, &uvBufferID);
-		glDeleteTextures(1, &textureID);
-		glDeleteProgram(programID);
+		CachedDeleteBuffer(instanceBufferID);
+		CachedDeleteVertexArray(vertexArrayID);
+		releaseCube();
+		ReleaseTexture(textureID);
+		ReleaseProgram(programID);
 	}
 };
 
-int randomInRange(int min, int max) {
-	return min + (std::rand() % (max - min + 1));
-}
+GLuint BuildingBatch::vertexBufferID = 0;
+GLuint BuildingBatch::uvBufferID = 0;
+GLuint BuildingBatch::indexBufferID = 0;
+int BuildingBatch::cubeRefCount = 0;
+
 struct Scene {
-	std::vector<Building> buildings;
+	BuildingBatch buildings;
 	Island island;
 	Cloud cloud;
 	Surface surface;
@@ -2072,91 +1235,138 @@ struct Scene {
 	Tree tree;
 	Tree tree2;
 	Rock rock;
-	// Initialize all elements of the scene
-	void initialize(const glm::vec3& offset) {
-		// Initialize the grid of buildings
-		for (int x = -500; x + 320 <= 1000; x += 320) {
-			for (int y = 180; y + 320<= 1000; y += 320) {
-				int innerXMin = x + (320 - 150) / 2;
-				int innerXMax = innerXMin + 150;
-				int innerYMin = y + (320 - 150) / 2;
-				int innerYMax = innerYMin + 150;
-				float rotation = randomInRange(0, 110);
-				int randomX = randomInRange(innerXMin, innerXMax - 1);
-				int randomY = randomInRange(innerYMin, innerYMax - 1);
-				int cube = randomInRange(60,100);
-				glm::vec3 size = glm::vec3(cube, cube, cube);
-				glm::vec3 position = glm::vec3(randomX, -440 + (cube), randomY) + offset;
-				Building b1;
-				int randomTexture = randomInRange(1, 4);
-				char newFilePath[50];
-				sprintf(newFilePath, "../../../lab2/textures/facade%d.jpg", randomTexture);
-				b1.initialize(position, size, newFilePath, 1, glm::vec3(0.0f, rotation, 0.0f));
-				buildings.push_back(b1);
-			}
-		}
-		rock.initialize(offset + glm::vec3(0, -400, -200), glm::vec3(10, 10, 10), "../../../lab2/rock.obj");
-		tree.initialize(offset + glm::vec3(400, -350, 1000), glm::vec3(10, 10, 10), "../../../lab2/tree.obj");
-		tree2.initialize(offset + glm::vec3(200, -350, -200), glm::vec3(10, 10, 10), "../../../lab2/tree.obj");
-
-		// Initialize the island
-		island.initialize(offset, glm::vec3(20, 20, 20), "../../../lab2/textures/facade1.jpg", "../../../lab2/test.obj");
 
-		// Initialize the cloud
-		cloud.initialize(offset + glm::vec3(200, 200, 200), glm::vec3(5, 5, 5), "../../../lab2/textures/facade1.jpg", "../../../lab2/cloud.obj");
+	// World-space boxes for culling: the meshObjectCount objects in render
+	// order, then one per building. The tile box encloses all of them.
+	static const size_t meshObjectCount = 7;
+	BoundsList bounds;
+	glm::vec3 tileCenter;
+	glm::vec3 tileExtent;
+	std::vector<unsigned char> visible;
+
+	static void addMeshBounds(BoundsList& bounds, const GpuMesh* mesh, glm::vec3 position, glm::vec3 scale) {
+		glm::mat4 modelMatrix = glm::scale(glm::translate(glm::mat4(1.0f), position), scale);
+		glm::vec3 center, extent;
+		TransformBounds(modelMatrix, mesh->boundsMin, mesh->boundsMax, center, extent);
+		bounds.add(center, extent);
+	}
 
-		// Initialize the surface
-		surface.initialize(offset + glm::vec3(0, 3, 0), glm::vec3(20, 20, 20), "../../../lab2/textures/facade1.jpg", "../../../lab2/testsurface.obj");
+	// Upload a tile generated by the TileStreamer one object per step, so the
+	// UploadScheduler can spread it over frames. Only GL work happens here.
+	static const int uploadSteps = 8;
+
+	void uploadStep(const TileData& tile, int step) {
+		PROFILE_SCOPE("Scene::uploadStep");
+		const glm::vec3& offset = tile.offset;
+
+		switch (step) {
+		case 0:
+			// Initialize the grid of buildings
+			buildings.initialize(tile.buildings, tile.facadePaths, tile.facades);
+			break;
+		case 1:
+			rock.initialize(offset + glm::vec3(0, -400, -200), glm::vec3(10, 10, 10), rockMeshPath, tile.rock);
+			break;
+		case 2:
+			tree.initialize(offset + glm::vec3(400, -350, 1000), glm::vec3(10, 10, 10), treeMeshPath, tile.tree);
+			break;
+		case 3:
+			tree2.initialize(offset + glm::vec3(200, -350, -200), glm::vec3(10, 10, 10), treeMeshPath, tile.tree);
+			break;
+		case 4:
+			// Initialize the island
+			island.initialize(offset, glm::vec3(20, 20, 20), "../../../lab2/textures/facade1.jpg", islandMeshPath, tile.island, tile.facades[0]);
+			break;
+		case 5:
+			// Initialize the cloud
+			cloud.initialize(offset + glm::vec3(200, 200, 200), glm::vec3(5, 5, 5), "../../../lab2/textures/facade1.jpg", cloudMeshPath, tile.cloud, tile.facades[0]);
+			break;
+		case 6:
+			// Initialize the surface
+			surface.initialize(offset + glm::vec3(0, 3, 0), glm::vec3(20, 20, 20), "../../../lab2/textures/facade1.jpg", surfaceMeshPath, tile.surface, tile.facades[0]);
+			break;
+		case 7:
+			// Initialize the spire
+			spire.initialize(offset + glm::vec3(250, -400, 1200), glm::vec3(5, 10, 5), "../../../lab2/textures/facade1.jpg", spireMeshPath, tile.spire, tile.facades[0]);
+			computeBounds();
+			break;
+		}
+	}
 
-		// Initialize the spire
-		spire.initialize(offset + glm::vec3(250, -400, 1200), glm::vec3(5, 10, 5), "../../../lab2/textures/facade1.jpg", "../../../lab2/spire.obj");
+	// Everything is static, so the bounds are computed once
+	void computeBounds() {
+		bounds.clear();
+		addMeshBounds(bounds, island.mesh, island.position, island.scale);
+		addMeshBounds(bounds, cloud.mesh, cloud.position, cloud.scale);
+		addMeshBounds(bounds, surface.mesh, surface.position, surface.scale);
+		addMeshBounds(bounds, spire.mesh, spire.position, spire.scale);
+		addMeshBounds(bounds, tree.mesh, tree.position, tree.scale);
+		addMeshBounds(bounds, tree2.mesh, tree2.position, tree2.scale);
+		addMeshBounds(bounds, rock.mesh, rock.position, rock.scale);
+		buildings.addBounds(bounds);
+		bounds.merged(tileCenter, tileExtent);
 	}
 
-	// Render all elements of the scene
-	void render(glm::mat4 vp){
-		// Render buildings
-		for (size_t i = 0; i < buildings.size(); ++i) {
-			buildings[i].render(vp);
+	// Queue the draws of every visible element of the scene
+	void submit(RenderQueue& queue, glm::mat4 vp, const Frustum& frustum){
+		PROFILE_SCOPE("Scene::submit");
+		// Reject the whole tile first, then test every object
+		if (!IsBoxVisible(frustum, tileCenter, tileExtent)) {
+			return;
 		}
+		CullBounds(frustum, bounds, visible);
+
+		// Buildings, sorted by the depth of the tile centre
+		float tileDepth = (vp * glm::vec4(tileCenter, 1.0f)).w;
+		buildings.submit(queue, visible.data() + meshObjectCount, tileDepth);
+
+		// Other components
+		if (visible[0]) island.submit(queue, vp);
+		if (visible[1]) cloud.submit(queue, vp);
+		if (visible[2]) surface.submit(queue, vp);
+		if (visible[3]) spire.submit(queue, vp);
+		if (visible[4]) tree.submit(queue, vp);
+		if (visible[5]) tree2.submit(queue, vp);
+		if (visible[6]) rock.submit(queue, vp);
+	}
 
-		// Render other components
-		island.render(vp);
-		cloud.render(vp);
-		surface.render(vp);
-		spire.render(vp);
-		tree.render(vp);
-		tree2.render(vp);
-		rock.render(vp); 
+	// What keeping the tile around costs, shared meshes and textures excluded
+	size_t memoryBytes() const {
+		return sizeof(Scene) + buildings.memoryBytes() + bounds.size() * 6 * sizeof(float) + visible.capacity();
 	}
 
-	// Cleanup resources for the scene
-	void cleanup() {
+	// Cleanup resources for the scene, or of its first steps when the
+	// upload was dropped halfway
+	void cleanup(int steps = uploadSteps) {
 		// Cleanup buildings
-		for (size_t i = 0; i < buildings.size(); ++i) {
-			buildings[i].cleanup();
-		}
-		buildings.clear();
+		if (steps > 0) buildings.cleanup();
 
 		// Cleanup other components
-		island.cleanup();
-		cloud.cleanup();
-		surface.cleanup();
-		spire.cleanup();
-		tree.cleanup();
-		rock.cleanup();
-		tree2.cleanup();
+		if (steps > 1) rock.cleanup();
+		if (steps > 2) tree.cleanup();
+		if (steps > 3) tree2.cleanup();
+		if (steps > 4) island.cleanup();
+		if (steps > 5) cloud.cleanup();
+		if (steps > 6) surface.cleanup();
+		if (steps > 7) spire.cleanup();
 	}
 };
-struct Point2D {
-	int x;
-	int z;
-};
 
 
 
 
-int main(void)
+int main(int argc, char **argv)
 {
+	BenchmarkOptions benchmark;
+	if (!ParseBenchmarkOptions(argc, argv, benchmark))
+	{
+		return -1;
+	}
+	if (benchmark.kernelBenchmark)
+	{
+		return RunMat4KernelBenchmark();
+	}
+
 	// Initialise GLFW
 	if (!glfwInit())
 	{
@@ -2168,9 +1378,11 @@ int main(void)
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // For MacOS
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// Headless runs only need the context, frames go to an offscreen target
+	glfwWindowHint(GLFW_VISIBLE, benchmark.headless ? GL_FALSE : GL_TRUE);
 
 	// Open a window and create its OpenGL context
-	window = glfwCreateWindow(1024, 768, "Lab 2", NULL, NULL);
+	window = glfwCreateWindow(benchmark.width, benchmark.height, "Lab 2", NULL, NULL);
 	if (window == NULL)
 	{
 		std::cerr << "Failed to open a GLFW window." << std::endl;
@@ -2178,6 +1390,7 @@ int main(void)
 		return -1;
 	}
 	glfwMakeContextCurrent(window);
+	PROFILE_THREAD("Render");
 
 	// Ensure we can capture the escape key being pressed below
 	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
@@ -2191,11 +1404,34 @@ int main(void)
 		return -1;
 	}
 
+	// Reuse linked shader programs from previous runs when the driver allows it
+	InitProgramBinaryCache(glfwGetProcAddress);
+
+	// Camera and light uniform buffer, attached to every program on load
+	InitFrameConstants();
+	PROFILE_GPU_INIT();
+
+	// Texture uploads are staged through pixel buffers, so they do not block
+	InitPixelUploadRing(4);
+
+	OffscreenTarget offscreen;
+	GpuTimerRing gpuTimers;
+	BenchmarkReport report;
+	if (benchmark.headless)
+	{
+		if (!CreateOffscreenTarget(benchmark.width, benchmark.height, offscreen))
+		{
+			glfwTerminate();
+			return -1;
+		}
+		gpuTimers.create(8);
+	}
+
 	// Background
 	glClearColor(0.2f, 0.2f, 0.25f, 0.0f);
 
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+	CachedEnable(GL_DEPTH_TEST, true);
+	CachedEnable(GL_CULL_FACE, true);
 	MyBot bot;
 	bot.initialize();
 
@@ -2207,48 +1443,90 @@ int main(void)
 
 
 	std::vector<Scene> scenes;
-	std::vector<Point2D> middlePoints;
-
-	int startx = -6000;
-	int startz = -6000;
-	for (int i = 0; i < 3; i++) {
-		for (int j = 0; j < 3; j++) {
-			Scene scene;
-			scene.initialize(glm::vec3(i * 6000+startx, 0, j * 6000+startz));
-			scenes.push_back(scene);
-			Point2D point;
-			point.x = i * 6000 + startx;
-			point.z = j * 6000 + startz;
-			middlePoints.push_back(point);
-		}
-	
-	}
+	RenderQueue renderQueue;
+	GLStateCounters glCalls = { 0, 0 };		// State calls of the last frame
 
 	// Camera setup
 	eye_center = glm::vec3(0.0f, 0.0f, 2500.0f);
 	lookat = glm::vec3(0.0f, 0.0f, 0.0f); // Assuming the camera looks at the origin
 	viewDistance = 3000.0f; // Update the viewDistance to match
+	if (benchmark.headless) {
+		BenchmarkCameraPose(benchmark, 0, eye_center, lookat);
+	}
+
+	// Tiles are generated on worker threads, the render thread only uploads them
+	unsigned hardwareThreads = std::thread::hardware_concurrency();
+	TileStreamer streamer;
+	streamer.start(hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+
+	// Scenes are indexed by tile manager slot
+	TileManager tiles(benchmark.tileRadius, (size_t)benchmark.tileCacheMegabytes << 20);
+	std::vector<TileManager::Request> tileRequests;
+	std::vector<int> releasedTiles;
+	std::vector<int> cancelledTiles;
+	std::vector<int> promotedTiles;
+	std::vector<double> tileRequestTimes;	// For the swap latency
+	int tileSlot;
+	TileData tileData;
+
+	// Finished tiles wait here, by slot, until their upload steps have run
+	std::vector<TileData> stagedTiles;
+	UploadScheduler uploads(benchmark.uploadBudgetMicroseconds / 1000.0, (size_t)benchmark.uploadBudgetKilobytes << 10);
+	int uploadSlot, uploadStep;
+
+	// The tiles around the camera are needed before the first frame
+	tiles.update(eye_center, glm::vec3(0.0f), tileRequests, releasedTiles, cancelledTiles, promotedTiles);
+	for (size_t i = 0; i < tileRequests.size(); ++i) {
+		streamer.request(tileRequests[i].slot, tileRequests[i].offset);
+	}
+	tileRequests.clear();
+	cancelledTiles.clear();
+	scenes.resize(tiles.slotCount());
+	stagedTiles.resize(tiles.slotCount());
+	tileRequestTimes.resize(tiles.slotCount(), 0.0);
+	while (streamer.wait(tileSlot, tileData)) {
+		if (tiles.acceptTile(tileSlot, tileData.coordinate)) {
+			uploads.add(tileSlot, Scene::uploadSteps, tileData.offset);
+			stagedTiles[tileSlot] = std::move(tileData);
+		}
+	}
+	uploads.beginFrame(eye_center, true);
+	while (uploads.next(uploadSlot, uploadStep)) {
+		scenes[uploadSlot].uploadStep(stagedTiles[uploadSlot], uploadStep);
+		if (uploads.stepDone()) {
+			tiles.tileReady(uploadSlot, scenes[uploadSlot].memoryBytes());
+			stagedTiles[uploadSlot] = TileData();
+		}
+	}
 
 	glm::mat4 viewMatrix, projectionMatrix;
     glm::float32 FoV = 45;
 	glm::float32 zNear = 0.1f;
 	glm::float32 zFar = 6000.0f;
-	projectionMatrix = glm::perspective(glm::radians(FoV), 4.0f / 3.0f, zNear, zFar);
+	projectionMatrix = glm::perspective(glm::radians(FoV), float(benchmark.width) / float(benchmark.height), zNear, zFar);
 	std::cout << "Initial lookat: (" << lookat.x << ", " << lookat.y << ", " << lookat.z << ")\n";
 
-	int currentMinX = -3000;
-	int currentMaxX = 3000;
-	int currentMaxZ = 3000;
-	int currentMinZ = -3000;
 
 
 	// Time and frame rate tracking
 	static double lastTime = glfwGetTime();
 	float time = 0.0f;			// Animation time
-	float fTime = 0.0f;			// Time for measuring fps
-	unsigned long frames = 0;
+	float fTime = 0.0f;			// Time since the title was updated
+	glm::vec3 lastEye = eye_center;
+	glm::vec3 cameraVelocity(0.0f);	// Smoothed, for tile prefetching
+	int benchmarkFrame = 0;
+	size_t benchmarkTimer = GpuTimerRing::noSlot;
+	std::vector<GpuTimerResult> gpuResults;
 	do
 	{
+		PROFILE_SCOPE("Frame");
+		double frameStart = glfwGetTime();
+		int tileSwaps = 0;
+		if (benchmark.headless) {
+			BenchmarkCameraPose(benchmark, benchmarkFrame, eye_center, lookat);
+			benchmarkTimer = gpuTimers.begin(benchmarkFrame);
+		}
+
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		// Print updated lookat coordinates only if it has changed
 		if (lookat != lastLookat)
@@ -2260,112 +1538,196 @@ int main(void)
 		viewMatrix = glm::lookAt(eye_center, lookat, up);
 
 		glm::mat4 vp = projectionMatrix * viewMatrix;
+		Frustum frustum = ExtractFrustum(vp);
+
+		// One upload of the camera and light for all programs this frame
+		FrameConstants frameConstants;
+		frameConstants.view = viewMatrix;
+		frameConstants.projection = projectionMatrix;
+		frameConstants.viewProjection = vp;
+		frameConstants.cameraPosition = glm::vec4(eye_center, 1.0f);
+		frameConstants.lightPosition = glm::vec4(lightPosition, 1.0f);
+		frameConstants.lightIntensity = glm::vec4(lightIntensity, 0.0f);
+		UpdateFrameConstants(frameConstants);
 
 		// Render the building
-		glm::mat4 viewMatrixSkybox = glm::mat4(glm::mat3(viewMatrix)); // Remove translation
-		glm::mat4 vpSkybox = projectionMatrix * viewMatrixSkybox;
-		glDepthFunc(GL_LEQUAL);
-		glDepthMask(GL_FALSE);
-		skybox.render(vpSkybox);
-		glDepthMask(GL_TRUE);
-		glDepthFunc(GL_LESS);
+		{
+			PROFILE_GPU_SCOPE("Skybox");
+			CachedDepthFunc(GL_LEQUAL);
+			CachedDepthMask(GL_FALSE);
+			skybox.render();
+			CachedDepthMask(GL_TRUE);
+			CachedDepthFunc(GL_LESS);
+		}
 		
-		if (eye_center.x > currentMaxX) {
-			for (size_t i = 0; i < middlePoints.size(); ++i) {
-				if (middlePoints[i].x == currentMinX-3000) {
-					middlePoints[i].x = currentMaxX+9000;
-					scenes[i].cleanup();
-					Scene scene;
-					//std::cout << middlePoints[i].x << std::endl;
-					scene.initialize(glm::vec3(middlePoints[i].x, 0, middlePoints[i].z));
-					scenes[i] = scene;
-				}
-			}
-			currentMaxX += 6000;
-			currentMinX += 6000;
+		// Request the tiles that came into range or lie ahead, free the ones
+		// evicted from the cache, drop prefetches the camera turned away from
+		// and hurry the ones it reached before they were generated
+		tiles.update(eye_center, cameraVelocity, tileRequests, releasedTiles, cancelledTiles, promotedTiles);
+		for (size_t i = 0; i < releasedTiles.size(); ++i) {
+			scenes[releasedTiles[i]].cleanup();
 		}
-		else if (eye_center.x < currentMinX) {
-			for (size_t i = 0; i < middlePoints.size(); ++i) {
-				if (middlePoints[i].x == currentMaxX + 3000) {
-					middlePoints[i].x = currentMinX - 9000;
-					scenes[i].cleanup();
-					Scene scene;
-					scene.initialize(glm::vec3(middlePoints[i].x, 0, middlePoints[i].z));
-					scenes[i] = scene;
-					//std::cout << middlePoints[i].x << std::endl;  // Exited to the right (positive X direction)
-				}
+		releasedTiles.clear();
+		for (size_t i = 0; i < cancelledTiles.size(); ++i) {
+			streamer.cancel(cancelledTiles[i]);
+			int uploadedSteps = uploads.remove(cancelledTiles[i]);
+			if (uploadedSteps >= 0) {
+				scenes[cancelledTiles[i]].cleanup(uploadedSteps);
+				stagedTiles[cancelledTiles[i]] = TileData();
 			}
-			currentMaxX -= 6000;
-			currentMinX -= 6000;
 		}
-		else if (eye_center.z > currentMaxZ) {
-			for (size_t i = 0; i < middlePoints.size(); ++i) {
-				if (middlePoints[i].z == currentMinZ - 3000) {
-					middlePoints[i].x = currentMaxZ + 9000;
-					scenes[i].cleanup();
-					Scene scene;
-					//std::cout << middlePoints[i].z << std::endl;
-					scene.initialize(glm::vec3(middlePoints[i].x, 0, middlePoints[i].z));
-					scenes[i] = scene;
-				}
+		cancelledTiles.clear();
+		for (size_t i = 0; i < promotedTiles.size(); ++i) {
+			streamer.promote(promotedTiles[i]);
+		}
+		promotedTiles.clear();
+		if (tiles.slotCount() > scenes.size()) {
+			scenes.resize(tiles.slotCount());
+			stagedTiles.resize(tiles.slotCount());
+			tileRequestTimes.resize(tiles.slotCount(), 0.0);
+		}
+		for (size_t i = 0; i < tileRequests.size(); ++i) {
+			streamer.request(tileRequests[i].slot, tileRequests[i].offset, tileRequests[i].speculative);
+			tileRequestTimes[tileRequests[i].slot] = glfwGetTime();
+		}
+		tileRequests.clear();
+
+		// Queue tiles the workers have finished; stale ones were dropped meanwhile
+		while (streamer.poll(tileSlot, tileData)) {
+			if (tiles.acceptTile(tileSlot, tileData.coordinate)) {
+				uploads.add(tileSlot, Scene::uploadSteps, tileData.offset);
+				stagedTiles[tileSlot] = std::move(tileData);
 			}
-			currentMaxZ += 6000;
-			currentMinZ += 6000;
 		}
-		else if (eye_center.z < currentMinZ) {
-			for (size_t i = 0; i < middlePoints.size(); ++i) {
-				if (middlePoints[i].z == currentMaxZ + 3000) {
-					middlePoints[i].z = currentMinZ - 9000;
-					scenes[i].cleanup();
-					Scene scene;
-					scene.initialize(glm::vec3(middlePoints[i].x, 0, middlePoints[i].z));
-					scenes[i] = scene;
-					//std::cout << middlePoints[i].z << std::endl;  // Exited to the right (positive X direction)
-				}
+
+		// Upload within the frame budget, tiles nearest to the camera first
+		uploads.beginFrame(eye_center);
+		while (uploads.next(uploadSlot, uploadStep)) {
+			scenes[uploadSlot].uploadStep(stagedTiles[uploadSlot], uploadStep);
+			if (!uploads.stepDone()) {
+				continue;
+			}
+			tiles.tileReady(uploadSlot, scenes[uploadSlot].memoryBytes());
+			stagedTiles[uploadSlot] = TileData();
+			NoteFrameEvent(FrameEventTileSwap);
+			if (benchmark.headless) {
+				report.tileSwapLatencies.push_back((glfwGetTime() - tileRequestTimes[uploadSlot]) * 1000.0);
+				tileSwaps++;
 			}
-			currentMaxZ -= 6000;
-			currentMinZ -= 6000;
 		}
-		//else {
-		//	//std::cout << "in" << std::endl;  // Exited to the right (positive X direction)
-		//} 
 		// Swap buffers
 		for (size_t i = 0; i < scenes.size(); ++i) {
-			scenes[i].render(vp);
+			if (tiles.isResident((int)i)) {
+				scenes[i].submit(renderQueue, vp, frustum);
+			}
+		}
+		{
+			PROFILE_GPU_SCOPE("RenderQueue::flush");
+			renderQueue.flush();
 		}
 		double currentTime = glfwGetTime();
 		float deltaTime = float(currentTime - lastTime);
 		lastTime = currentTime;
+		frameStats.addFrame(deltaTime * 1000.0);
 
-		if (playAnimation) {
+		// The benchmark path moves by a fixed step per frame, the keys by wall clock
+		float motionTime = benchmark.headless ? BenchmarkFrameTime(1) : deltaTime;
+		if (motionTime > 0.0f) {
+			cameraVelocity = glm::mix(cameraVelocity, (eye_center - lastEye) / motionTime, 0.2f);
+		}
+		lastEye = eye_center;
+
+		if (benchmark.headless) {
+			// Fixed clock so every run renders the same frames
+			time = BenchmarkFrameTime(benchmarkFrame) * playbackSpeed;
+			bot.update(time);
+		}
+		else if (playAnimation) {
 			time += deltaTime * playbackSpeed;
 			bot.update(time);
 		}
 
-		bot.render(vp);
+		bot.render();
+
+		if (benchmark.headless) {
+			gpuTimers.end(benchmarkTimer);
+
+			BenchmarkFrame sample;
+			sample.cpuMilliseconds = (glfwGetTime() - frameStart) * 1000.0;
+			sample.gpuMilliseconds = -1.0;
+			sample.draws = renderQueue.stats.draws;
+			sample.glCallsIssued = TakeGLStateCounters().issued;
+			sample.tileSwaps = tileSwaps;
+			sample.uploadBytes = uploads.frameBytes();
+			report.frames.push_back(sample);
+
+			if (benchmark.captureEvery > 0 && benchmarkFrame % benchmark.captureEvery == 0) {
+				char path[512];
+				snprintf(path, sizeof(path), "%s_%05d.png", benchmark.capturePrefix.c_str(), benchmarkFrame);
+				SaveOffscreenTarget(offscreen, path);
+			}
+			gpuTimers.collect(gpuResults, false);
+			PROFILE_GPU_COLLECT();
+			benchmarkFrame++;
+			glfwPollEvents();
+			continue;
+		}
 
 
-		frames++;
 		fTime += deltaTime;
 		if (fTime > 2.0f) {
-			float fps = frames / fTime;
-			frames = 0;
 			fTime = 0;
 
 			std::stringstream stream;
-			stream << std::fixed << std::setprecision(2) << "Lab 4 | Frames per second (FPS): " << fps;
+			stream << std::fixed << std::setprecision(2) << "Lab 4 | Frame ms p50/p95/p99: "
+				<< frameStats.recent.percentile(0.5) << "/" << frameStats.recent.percentile(0.95) << "/"
+				<< frameStats.recent.percentile(0.99) << " | Hitches: " << frameStats.hitchCount()
+				<< " | Tiles resident/cached: " << tiles.residentCount() << "/" << tiles.cachedCount()
+				<< " | Draws: " << renderQueue.stats.draws
+				<< " | Program/texture/VAO changes: " << renderQueue.stats.programChanges << "/"
+				<< renderQueue.stats.textureChanges << "/" << renderQueue.stats.vertexArrayChanges
+				<< " | GL calls issued/elided: " << glCalls.issued << "/" << glCalls.elided;
 			glfwSetWindowTitle(window, stream.str().c_str());
 		}
 		glfwSwapBuffers(window);
+		glCalls = TakeGLStateCounters();
+		PROFILE_GPU_COLLECT();
 		glfwPollEvents();
 
 	} // Check if the ESC key was pressed or the window was closed
-	while (!glfwWindowShouldClose(window));
+	while (benchmark.headless ? benchmarkFrame < benchmark.frames : !glfwWindowShouldClose(window));
+
+	if (benchmark.headless) {
+		gpuTimers.collect(gpuResults, true);
+		for (size_t i = 0; i < gpuResults.size(); ++i) {
+			report.frames[gpuResults[i].tag].gpuMilliseconds = gpuResults[i].milliseconds;
+		}
+		WriteBenchmarkReport(benchmark, report);
+		gpuTimers.release();
+		ReleaseOffscreenTarget(offscreen);
+	}
 
-	for (size_t i = 0; i < scenes.size(); ++i) {
-		scenes[i].cleanup();
+	streamer.stop();
+	std::vector<int> allocatedTiles;
+	tiles.allocatedSlots(allocatedTiles);
+	for (size_t i = 0; i < allocatedTiles.size(); ++i) {
+		scenes[allocatedTiles[i]].cleanup();
+	}
+	while (!uploads.pending.empty()) {
+		int partial = uploads.pending.front().id;
+		scenes[partial].cleanup(uploads.remove(partial));
 	}
+	std::cout << "Tile cache: " << tiles.stats.hits << " hits, " << tiles.stats.misses << " misses, "
+		<< tiles.stats.evictions << " evictions, " << tiles.stats.prefetches << " prefetches, "
+		<< tiles.stats.promotions << " promotions, "
+		<< tiles.stats.cancellations << " cancellations" << std::endl;
 	skybox.cleanup();
+	frameStats.report(std::cout);
+	PROFILE_EXPORT("profile_trace.json");
+	PROFILE_GPU_RELEASE();
+	ReleaseFrameConstants();
+	ReleasePixelUploadRing();
+	std::cout << "Uploads: " << UploadedBytes() / 1024 << " KB, " << PixelUploadStalls() << " pixel buffer stalls" << std::endl;
 	//roof.cleanup();
 	// Close OpenGL window and terminate GLFW
 	glfwTerminate();
@@ -2418,6 +1780,18 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 		//	std::cout << "Camera Reset.\n";
 		//}
 
+		// Frame time summary so far
+		if (key == GLFW_KEY_F && action == GLFW_PRESS)
+		{
+			frameStats.report(std::cout);
+		}
+
+		// Write the profiler trace recorded so far
+		if (key == GLFW_KEY_P && action == GLFW_PRESS)
+		{
+			PROFILE_EXPORT("profile_trace.json");
+		}
+
 		// Exit application
 		if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		{
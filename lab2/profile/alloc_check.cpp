@@ -0,0 +1,60 @@
+#include "alloc_check.h"
+
+#ifdef ENABLE_PROFILER
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+static thread_local unsigned long long threadAllocations = 0;
+
+static void *CountedAllocate(std::size_t size)
+{
+	threadAllocations++;
+	void *memory = std::malloc(size ? size : 1);
+	if (!memory) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void *operator new(std::size_t size)
+{
+	return CountedAllocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+	return CountedAllocate(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+	std::free(memory);
+}
+
+unsigned long long ThreadAllocationCount()
+{
+	return threadAllocations;
+}
+
+NoAllocationScope::NoAllocationScope(const char *name, bool armed, bool *reported)
+	: name(name), reported(armed && !*reported ? reported : NULL), startCount(threadAllocations)
+{
+}
+
+NoAllocationScope::~NoAllocationScope()
+{
+	if (reported && threadAllocations != startCount) {
+		*reported = true;
+		std::cerr << name << " allocated " << threadAllocations - startCount
+			<< " times after warming up" << std::endl;
+	}
+}
+
+#endif
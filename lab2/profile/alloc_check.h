@@ -0,0 +1,41 @@
+#ifndef _ALLOC_CHECK_H_
+#define _ALLOC_CHECK_H_
+
+// Guards code that must not touch the heap once warmed up, like the per
+// frame bot update. Built only with ENABLE_PROFILER, which replaces the
+// global operator new to count allocations per thread; otherwise the macro
+// expands to nothing.
+//
+//   PROFILE_NO_ALLOC_SCOPE("name", armed)  reports the first time the
+//                                          enclosing block allocates while
+//                                          armed is true
+//
+// Names must be string literals.
+
+#include "profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+// Heap allocations made by the calling thread so far
+unsigned long long ThreadAllocationCount();
+
+struct NoAllocationScope {
+	const char *name;
+	bool *reported;
+	unsigned long long startCount;
+
+	NoAllocationScope(const char *name, bool armed, bool *reported);
+	~NoAllocationScope();
+};
+
+#define PROFILE_NO_ALLOC_SCOPE(name, armed) \
+	static bool PROFILE_CONCAT(allocReported, __LINE__) = false; \
+	NoAllocationScope PROFILE_CONCAT(noAllocScope, __LINE__)(name, armed, &PROFILE_CONCAT(allocReported, __LINE__))
+
+#else
+
+#define PROFILE_NO_ALLOC_SCOPE(name, armed)
+
+#endif
+
+#endif
@@ -0,0 +1,170 @@
+#include "frame_stats.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+
+static const int linearBuckets = 64;
+static const int subBuckets = 32;
+static const int maxExponent = 30;
+static const int bucketCount = linearBuckets + (maxExponent - 6) * subBuckets;
+
+static const char *const frameEventNames[FrameEventCount] = { "none", "tile swap", "asset load" };
+
+static std::atomic<int> pendingEvent(FrameEventNone);
+
+const double FrameStats::hitchFactor = 2.0;
+
+void NoteFrameEvent(FrameEvent event)
+{
+	pendingEvent.store(event);
+}
+
+static int BucketIndex(double milliseconds)
+{
+	double micro = milliseconds * 1000.0;
+	if (!(micro >= 0.0)) {
+		return 0;
+	}
+	if (micro >= double(1u << maxExponent)) {
+		return bucketCount - 1;
+	}
+	unsigned value = (unsigned)micro;
+	if (value < (unsigned)linearBuckets) {
+		return value;
+	}
+
+	// value >> shift keeps the top five bits below the leading one
+	int exponent = 0;
+	while ((value >> (exponent + 1)) != 0) {
+		exponent++;
+	}
+	int shift = exponent - 5;
+	return linearBuckets + (exponent - 6) * subBuckets + (int)(value >> shift) - subBuckets;
+}
+
+static double BucketMiddle(int index)
+{
+	if (index < linearBuckets) {
+		return (index + 0.5) * 0.001;
+	}
+	int exponent = (index - linearBuckets) / subBuckets + 6;
+	int mantissa = (index - linearBuckets) % subBuckets + subBuckets;
+	double width = std::ldexp(1.0, exponent - 5);
+	return (mantissa * width + width * 0.5) * 0.001;
+}
+
+FrameHistogram::FrameHistogram()
+	: buckets(bucketCount, 0), count(0), maxMilliseconds(0.0)
+{
+}
+
+void FrameHistogram::add(double milliseconds)
+{
+	buckets[BucketIndex(milliseconds)]++;
+	count++;
+	if (milliseconds > maxMilliseconds) {
+		maxMilliseconds = milliseconds;
+	}
+}
+
+void FrameHistogram::remove(double milliseconds)
+{
+	unsigned &bucket = buckets[BucketIndex(milliseconds)];
+	if (bucket > 0) {
+		bucket--;
+		count--;
+	}
+}
+
+double FrameHistogram::percentile(double fraction) const
+{
+	if (count == 0) {
+		return 0.0;
+	}
+	unsigned rank = (unsigned)std::ceil(fraction * count);
+	if (rank == 0) {
+		rank = 1;
+	}
+	unsigned seen = 0;
+	for (int i = 0; i < bucketCount; i++) {
+		seen += buckets[i];
+		if (seen >= rank) {
+			return BucketMiddle(i);
+		}
+	}
+	return BucketMiddle(bucketCount - 1);
+}
+
+FrameStats::FrameStats()
+	: window(windowFrames, 0.0), windowNext(0), frameIndex(0), lastEvent(FrameEventNone), lastEventFrame(0)
+{
+	memset(hitches, 0, sizeof(hitches));
+}
+
+void FrameStats::addFrame(double milliseconds)
+{
+	FrameEvent event = (FrameEvent)pendingEvent.exchange(FrameEventNone);
+	if (event != FrameEventNone) {
+		lastEvent = event;
+		lastEventFrame = frameIndex;
+	}
+
+	// Compare against the median before this frame joins it
+	if (frameIndex >= (unsigned)warmupFrames && milliseconds > hitchFactor * recent.percentile(0.5)) {
+		bool recentEvent = lastEvent != FrameEventNone && frameIndex - lastEventFrame <= 1;
+		hitches[recentEvent ? lastEvent : FrameEventNone]++;
+	}
+
+	if (frameIndex >= (unsigned)windowFrames) {
+		recent.remove(window[windowNext]);
+	}
+	window[windowNext] = milliseconds;
+	windowNext = (windowNext + 1) % windowFrames;
+	recent.add(milliseconds);
+	total.add(milliseconds);
+	frameIndex++;
+}
+
+unsigned FrameStats::hitchCount() const
+{
+	unsigned count = 0;
+	for (int i = 0; i < FrameEventCount; i++) {
+		count += hitches[i];
+	}
+	return count;
+}
+
+static void ReportHistogram(std::ostream &out, const char *label, const FrameHistogram &histogram, double maxMilliseconds)
+{
+	out << label << " (" << histogram.count << " frames): p50 " << histogram.percentile(0.5)
+		<< " ms, p95 " << histogram.percentile(0.95) << " ms, p99 " << histogram.percentile(0.99)
+		<< " ms, max " << maxMilliseconds << " ms" << std::endl;
+}
+
+void FrameStats::report(std::ostream &out) const
+{
+	// The window max is exact, the histogram only keeps the all-time one
+	double recentMax = 0.0;
+	size_t recentCount = frameIndex < (unsigned)windowFrames ? frameIndex : windowFrames;
+	for (size_t i = 0; i < recentCount; i++) {
+		if (window[i] > recentMax) {
+			recentMax = window[i];
+		}
+	}
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(2);
+	ReportHistogram(out, "Frame times, recent", recent, recentMax);
+	ReportHistogram(out, "Frame times, total", total, total.maxMilliseconds);
+
+	out << "Hitches (> " << hitchFactor << "x median): " << hitchCount();
+	for (int i = 0; i < FrameEventCount; i++) {
+		out << (i == 0 ? " (" : ", ") << frameEventNames[i] << " " << hitches[i];
+	}
+	out << ")" << std::endl;
+	out.flags(flags);
+	out.precision(precision);
+}
@@ -0,0 +1,63 @@
+#ifndef _FRAME_STATS_H_
+#define _FRAME_STATS_H_
+
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+// Things that make a frame slow. Any thread can note one; the next frame
+// added to FrameStats takes it.
+enum FrameEvent {
+	FrameEventNone = 0,
+	FrameEventTileSwap,
+	FrameEventAssetLoad,
+	FrameEventCount
+};
+
+void NoteFrameEvent(FrameEvent event);
+
+// Log-linear histogram of frame times in microseconds: exact below 64 us,
+// then 32 buckets per power of two (about 3% error) up to 2^30 us.
+struct FrameHistogram {
+	std::vector<unsigned> buckets;
+	unsigned count;
+	double maxMilliseconds;
+
+	FrameHistogram();
+
+	void add(double milliseconds);
+	void remove(double milliseconds);
+
+	// Middle of the bucket holding the percentile, 0 when empty
+	double percentile(double fraction) const;
+};
+
+// Frame time percentiles over the recent frames and the whole run, plus
+// hitches: frames slower than hitchFactor times the recent median. A hitch
+// is blamed on the event noted in that frame or the one before, since an
+// upload usually shows up one frame late.
+struct FrameStats {
+	static const int windowFrames = 1200;
+	static const int warmupFrames = 30;		// No hitches until the median settles
+	static const double hitchFactor;
+
+	FrameHistogram recent;
+	FrameHistogram total;
+	std::vector<double> window;		// Ring of the recent frame times, exactly as added
+	size_t windowNext;
+	unsigned frameIndex;
+	FrameEvent lastEvent;
+	unsigned lastEventFrame;
+	unsigned hitches[FrameEventCount];
+
+	FrameStats();
+
+	void addFrame(double milliseconds);
+
+	unsigned hitchCount() const;
+
+	// One line each for the recent window and the whole run, then the hitches
+	void report(std::ostream &out) const;
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+#include <render/gpu_timer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Events kept per thread, a power of two; older ones are overwritten
+static const unsigned long long threadEventCapacity = 1 << 16;
+static const size_t gpuTimerSlots = 64;
+
+struct ProfileEvent {
+	const char *name;
+	long long startTime;		// Nanoseconds since the profiler clock started
+	long long duration;
+};
+
+// Only the owning thread writes events; written is published with release
+// order after each event so the exporter can read the ring without a lock
+struct ThreadTrace {
+	ProfileEvent events[threadEventCapacity];
+	std::atomic<unsigned long long> written;
+	std::atomic<const char *> name;
+	int threadID;
+	ThreadTrace *next;
+};
+
+// Traces are pushed onto this list once per thread and never freed, so the
+// exporter can walk it while threads come and go
+static std::atomic<ThreadTrace *> threadTraces(NULL);
+static std::atomic<int> nextThreadID(1);
+static thread_local ThreadTrace *currentTrace = NULL;
+
+static const std::chrono::steady_clock::time_point clockStart = std::chrono::steady_clock::now();
+
+// GPU timers live on the render thread only
+static GpuTimerRing gpuTimers;
+static std::vector<const char *> gpuScopeNames;
+static std::vector<ProfileEvent> gpuEvents;
+static long long gpuClockOffset = 0;		// Profiler clock minus GL_TIMESTAMP
+static bool gpuReady = false;
+
+static long long ProfilerNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - clockStart).count();
+}
+
+static ThreadTrace *CurrentTrace()
+{
+	if (currentTrace == NULL) {
+		ThreadTrace *trace = new ThreadTrace();
+		trace->written.store(0);
+		trace->name.store(NULL);
+		trace->threadID = nextThreadID.fetch_add(1);
+		trace->next = threadTraces.load();
+		while (!threadTraces.compare_exchange_weak(trace->next, trace)) {
+		}
+		currentTrace = trace;
+	}
+	return currentTrace;
+}
+
+ProfileScope::ProfileScope(const char *name)
+	: name(name), startTime(ProfilerNow())
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+	ThreadTrace *trace = CurrentTrace();
+	unsigned long long index = trace->written.load(std::memory_order_relaxed);
+	ProfileEvent &event = trace->events[index & (threadEventCapacity - 1)];
+	event.name = name;
+	event.startTime = startTime;
+	event.duration = ProfilerNow() - startTime;
+	trace->written.store(index + 1, std::memory_order_release);
+}
+
+void ProfilerSetThreadName(const char *name)
+{
+	CurrentTrace()->name.store(name);
+}
+
+static void SyncGpuClock()
+{
+	GLint64 gpuTime = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+	gpuClockOffset = ProfilerNow() - gpuTime;
+}
+
+void InitGpuProfiler()
+{
+	gpuTimers.create(gpuTimerSlots);
+	SyncGpuClock();
+	gpuReady = true;
+}
+
+void ReleaseGpuProfiler()
+{
+	gpuReady = false;
+	gpuTimers.release();
+}
+
+GpuProfileScope::GpuProfileScope(const char *name)
+	: slot(GpuTimerRing::noSlot)
+{
+	if (!gpuReady) {
+		return;
+	}
+	size_t tag = 0;
+	while (tag < gpuScopeNames.size() && gpuScopeNames[tag] != name) {
+		tag++;
+	}
+	if (tag == gpuScopeNames.size()) {
+		gpuScopeNames.push_back(name);
+	}
+	slot = gpuTimers.begin((int)tag);
+}
+
+GpuProfileScope::~GpuProfileScope()
+{
+	if (gpuReady) {
+		gpuTimers.end(slot);
+	}
+}
+
+void CollectGpuProfiler()
+{
+	if (!gpuReady) {
+		return;
+	}
+	std::vector<GpuTimerResult> results;
+	gpuTimers.collect(results, false);
+	SyncGpuClock();
+
+	// Same bound as a thread ring, dropping the older half when full
+	if (gpuEvents.size() + results.size() > threadEventCapacity) {
+		gpuEvents.erase(gpuEvents.begin(), gpuEvents.begin() + gpuEvents.size() / 2);
+	}
+	for (size_t i = 0; i < results.size(); i++) {
+		ProfileEvent event;
+		event.name = gpuScopeNames[results[i].tag];
+		event.startTime = (long long)results[i].beginTime + gpuClockOffset;
+		event.duration = (long long)(results[i].milliseconds * 1e6);
+		gpuEvents.push_back(event);
+	}
+}
+
+// Copies the events of a trace that were not overwritten while reading
+static void SnapshotTrace(const ThreadTrace &trace, std::vector<ProfileEvent> &events)
+{
+	unsigned long long end = trace.written.load(std::memory_order_acquire);
+	unsigned long long begin = end > threadEventCapacity ? end - threadEventCapacity : 0;
+	events.clear();
+	for (unsigned long long i = begin; i < end; i++) {
+		events.push_back(trace.events[i & (threadEventCapacity - 1)]);
+	}
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	unsigned long long after = trace.written.load(std::memory_order_relaxed);
+	unsigned long long valid = after > threadEventCapacity ? after - threadEventCapacity : 0;
+	if (valid > begin) {
+		size_t overwritten = (size_t)std::min(valid - begin, (unsigned long long)events.size());
+		events.erase(events.begin(), events.begin() + overwritten);
+	}
+}
+
+static void WriteEvents(std::ostream &out, const std::vector<ProfileEvent> &events, int threadID, bool &first)
+{
+	for (size_t i = 0; i < events.size(); i++) {
+		out << (first ? "\n" : ",\n") << "{\"name\":\"" << events[i].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+			<< threadID << ",\"ts\":" << events[i].startTime * 1e-3 << ",\"dur\":" << events[i].duration * 1e-3 << "}";
+		first = false;
+	}
+}
+
+static void WriteThreadName(std::ostream &out, int threadID, const char *name, bool &first)
+{
+	out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadID
+		<< ",\"args\":{\"name\":\"" << name << "\"}}";
+	first = false;
+}
+
+bool WriteProfilerTrace(const char *path)
+{
+	std::ofstream out(path);
+	if (!out) {
+		std::cerr << "Failed to write " << path << std::endl;
+		return false;
+	}
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	// The GPU gets track 0, threads count up from 1
+	bool first = true;
+	WriteThreadName(out, 0, "GPU", first);
+	WriteEvents(out, gpuEvents, 0, first);
+
+	std::vector<ProfileEvent> events;
+	for (ThreadTrace *trace = threadTraces.load(); trace != NULL; trace = trace->next) {
+		const char *name = trace->name.load();
+		if (name != NULL) {
+			WriteThreadName(out, trace->threadID, name, first);
+		}
+		SnapshotTrace(*trace, events);
+		WriteEvents(out, events, trace->threadID, first);
+	}
+	out << "\n]}\n";
+
+	std::cout << "Profiler trace written to " << path << std::endl;
+	return true;
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+// Scoped CPU and GPU markers, exported as Chrome trace_event JSON (open in
+// chrome://tracing or ui.perfetto.dev). Built only with ENABLE_PROFILER,
+// which CMake defines outside Release builds; otherwise every PROFILE_*
+// macro expands to nothing.
+//
+//   PROFILE_SCOPE("name")      CPU time of the enclosing block, any thread
+//   PROFILE_GPU_SCOPE("name")  CPU and GPU time of the block, render thread
+//   PROFILE_THREAD("name")     names the calling thread in the trace
+//   PROFILE_GPU_INIT()         after the GL context exists
+//   PROFILE_GPU_COLLECT()      once per frame, reads finished GPU timers
+//   PROFILE_GPU_RELEASE()      before the GL context goes away
+//   PROFILE_EXPORT("path")     writes everything recorded so far
+//
+// Names must be string literals. Each thread records into its own ring of
+// events without locks; the exporter copies the rings and drops events
+// that were overwritten while it read them.
+
+#ifdef ENABLE_PROFILER
+
+#include <cstddef>
+
+struct ProfileScope {
+	const char *name;
+	long long startTime;
+
+	explicit ProfileScope(const char *name);
+	~ProfileScope();
+};
+
+struct GpuProfileScope {
+	size_t slot;
+
+	explicit GpuProfileScope(const char *name);
+	~GpuProfileScope();
+};
+
+void ProfilerSetThreadName(const char *name);
+void InitGpuProfiler();
+void CollectGpuProfiler();
+void ReleaseGpuProfiler();
+bool WriteProfilerTrace(const char *path);
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) PROFILE_SCOPE(name); GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_THREAD(name) ProfilerSetThreadName(name)
+#define PROFILE_GPU_INIT() InitGpuProfiler()
+#define PROFILE_GPU_COLLECT() CollectGpuProfiler()
+#define PROFILE_GPU_RELEASE() ReleaseGpuProfiler()
+#define PROFILE_EXPORT(path) WriteProfilerTrace(path)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#define PROFILE_THREAD(name)
+#define PROFILE_GPU_INIT()
+#define PROFILE_GPU_COLLECT()
+#define PROFILE_GPU_RELEASE()
+#define PROFILE_EXPORT(path)
+
+#endif
+
+#endif
@@ -0,0 +1,32 @@
+#include "frame_constants.h"
+#include "gl_state.h"
+
+static GLuint frameConstantsBufferID = 0;
+
+void InitFrameConstants()
+{
+	glGenBuffers(1, &frameConstantsBufferID);
+	CachedBindBuffer(GL_UNIFORM_BUFFER, frameConstantsBufferID);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameConstants), NULL, GL_DYNAMIC_DRAW);
+	CachedBindBufferBase(GL_UNIFORM_BUFFER, frameConstantsBinding, frameConstantsBufferID);
+}
+
+void UpdateFrameConstants(const FrameConstants &constants)
+{
+	CachedBindBuffer(GL_UNIFORM_BUFFER, frameConstantsBufferID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameConstants), &constants);
+}
+
+void ReleaseFrameConstants()
+{
+	CachedDeleteBuffer(frameConstantsBufferID);
+	frameConstantsBufferID = 0;
+}
+
+void BindFrameConstantsBlock(GLuint programID)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(programID, "FrameConstants");
+	if (blockIndex != GL_INVALID_INDEX) {
+		glUniformBlockBinding(programID, blockIndex, frameConstantsBinding);
+	}
+}
@@ -0,0 +1,43 @@
+#ifndef _FRAME_CONSTANTS_H_
+#define _FRAME_CONSTANTS_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+// Uniform buffer binding point of the FrameConstants block. AcquireProgram
+// attaches the block of every program that declares it to this point.
+const GLuint frameConstantsBinding = 0;
+
+// Per-frame camera and light data, mirrored by this block in the shaders:
+//
+//   layout(std140) uniform FrameConstants {
+//       mat4 view;
+//       mat4 projection;
+//       mat4 viewProjection;
+//       vec4 cameraPosition;
+//       vec4 lightPosition;
+//       vec4 lightIntensity;
+//   };
+//
+// Only vec4 and mat4 members, so the C++ layout matches std140 as is.
+struct FrameConstants {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 cameraPosition;
+	glm::vec4 lightPosition;
+	glm::vec4 lightIntensity;
+};
+
+// Creates the uniform buffer and binds it to frameConstantsBinding
+void InitFrameConstants();
+
+// Call once per frame before the first draw
+void UpdateFrameConstants(const FrameConstants &constants);
+
+void ReleaseFrameConstants();
+
+// Attaches the program's FrameConstants block, if any, to the binding point
+void BindFrameConstantsBlock(GLuint programID);
+
+#endif
@@ -0,0 +1,123 @@
+#include "frustum.h"
+
+#include <cmath>
+
+Frustum ExtractFrustum(const glm::mat4 &viewProjection)
+{
+	// Gribb-Hartmann: each plane is the fourth row plus or minus another row.
+	// glm is column major, so row r is (m[0][r], m[1][r], m[2][r], m[3][r]).
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++) {
+		rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+	}
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+	for (int i = 0; i < 6; i++) {
+		float length = glm::length(glm::vec3(frustum.planes[i]));
+		if (length > 0.0f) {
+			frustum.planes[i] /= length;
+		}
+	}
+	return frustum;
+}
+
+void TransformBounds(const glm::mat4 &transform, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+	glm::vec3 &center, glm::vec3 &extent)
+{
+	glm::vec3 localCenter = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 localExtent = (boundsMax - boundsMin) * 0.5f;
+	center = glm::vec3(transform * glm::vec4(localCenter, 1.0f));
+
+	// Extent along each world axis is the abs-weighted sum of the local axes
+	for (int axis = 0; axis < 3; axis++) {
+		extent[axis] = std::fabs(transform[0][axis]) * localExtent.x +
+			std::fabs(transform[1][axis]) * localExtent.y +
+			std::fabs(transform[2][axis]) * localExtent.z;
+	}
+}
+
+bool IsBoxVisible(const Frustum &frustum, const glm::vec3 &center, const glm::vec3 &extent)
+{
+	for (int i = 0; i < 6; i++) {
+		const glm::vec4 &plane = frustum.planes[i];
+		float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+		float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+		if (distance + radius < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void BoundsList::clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+}
+
+void BoundsList::add(const glm::vec3 &center, const glm::vec3 &extent)
+{
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	extentX.push_back(extent.x);
+	extentY.push_back(extent.y);
+	extentZ.push_back(extent.z);
+}
+
+void BoundsList::merged(glm::vec3 &center, glm::vec3 &extent) const
+{
+	if (size() == 0) {
+		center = glm::vec3(0.0f);
+		extent = glm::vec3(0.0f);
+		return;
+	}
+	glm::vec3 boundsMin(centerX[0] - extentX[0], centerY[0] - extentY[0], centerZ[0] - extentZ[0]);
+	glm::vec3 boundsMax(centerX[0] + extentX[0], centerY[0] + extentY[0], centerZ[0] + extentZ[0]);
+	for (size_t i = 1; i < size(); i++) {
+		boundsMin = glm::min(boundsMin, glm::vec3(centerX[i] - extentX[i], centerY[i] - extentY[i], centerZ[i] - extentZ[i]));
+		boundsMax = glm::max(boundsMax, glm::vec3(centerX[i] + extentX[i], centerY[i] + extentY[i], centerZ[i] + extentZ[i]));
+	}
+	center = (boundsMin + boundsMax) * 0.5f;
+	extent = (boundsMax - boundsMin) * 0.5f;
+}
+
+void CullBounds(const Frustum &frustum, const BoundsList &bounds, std::vector<unsigned char> &visible)
+{
+	size_t count = bounds.size();
+	visible.assign(count, 1);
+	if (count == 0) {
+		return;
+	}
+
+	const float *cx = &bounds.centerX[0];
+	const float *cy = &bounds.centerY[0];
+	const float *cz = &bounds.centerZ[0];
+	const float *ex = &bounds.extentX[0];
+	const float *ey = &bounds.extentY[0];
+	const float *ez = &bounds.extentZ[0];
+	unsigned char *out = &visible[0];
+
+	// One plane at a time over all boxes: the inner loop is branch free over
+	// contiguous floats, which the compiler turns into 4 or 8 wide SIMD
+	for (int p = 0; p < 6; p++) {
+		const glm::vec4 &plane = frustum.planes[p];
+		float nx = plane.x, ny = plane.y, nz = plane.z, d = plane.w;
+		float ax = std::fabs(nx), ay = std::fabs(ny), az = std::fabs(nz);
+		for (size_t i = 0; i < count; i++) {
+			float distance = nx * cx[i] + ny * cy[i] + nz * cz[i] + d;
+			float radius = ax * ex[i] + ay * ey[i] + az * ez[i];
+			out[i] &= (unsigned char)(distance + radius >= 0.0f);
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef _FRUSTUM_H_
+#define _FRUSTUM_H_
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// Six world-space planes (xyz normal pointing inwards, w distance) of a
+// view-projection matrix: left, right, bottom, top, near, far
+struct Frustum {
+	glm::vec4 planes[6];
+};
+
+Frustum ExtractFrustum(const glm::mat4 &viewProjection);
+
+// World-space AABB of the local box [boundsMin, boundsMax] under transform
+void TransformBounds(const glm::mat4 &transform, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax,
+	glm::vec3 &center, glm::vec3 &extent);
+
+// True unless the box lies completely outside one of the planes
+bool IsBoxVisible(const Frustum &frustum, const glm::vec3 &center, const glm::vec3 &extent);
+
+// Axis-aligned boxes stored as centre and half extent, one array per
+// component, so the plane tests of consecutive boxes vectorise
+struct BoundsList {
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+	size_t size() const { return centerX.size(); }
+	void clear();
+	void add(const glm::vec3 &center, const glm::vec3 &extent);
+
+	// Box enclosing every entry
+	void merged(glm::vec3 &center, glm::vec3 &extent) const;
+};
+
+// visible[i] becomes 1 when box i intersects the frustum, 0 otherwise
+void CullBounds(const Frustum &frustum, const BoundsList &bounds, std::vector<unsigned char> &visible);
+
+#endif
@@ -0,0 +1,208 @@
+#include "gl_state.h"
+
+#include <cstring>
+
+static const int maxTextureUnits = 16;
+static const GLenum textureTargets[] = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP };
+static const int textureTargetCount = sizeof(textureTargets) / sizeof(textureTargets[0]);
+static const GLenum bufferTargets[] = { GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_PIXEL_PACK_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER };
+static const int bufferTargetCount = sizeof(bufferTargets) / sizeof(bufferTargets[0]);
+static const GLenum capabilities[] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND };
+static const int capabilityCount = sizeof(capabilities) / sizeof(capabilities[0]);
+
+struct TrackedValue {
+	GLuint value;
+	bool known;
+};
+
+struct GLStateShadow {
+	TrackedValue program;
+	TrackedValue vertexArray;
+	TrackedValue activeTexture;
+	TrackedValue textures[maxTextureUnits][textureTargetCount];
+	TrackedValue buffers[bufferTargetCount];
+	TrackedValue capabilities[capabilityCount];
+	TrackedValue depthFunc;
+	TrackedValue depthMask;
+	TrackedValue cullFace;
+	GLStateCounters counters;
+};
+
+// All members start out unknown (zero-initialised)
+static GLStateShadow state;
+
+// Returns true when the call has to be issued, and records the new value
+static bool Update(TrackedValue &tracked, GLuint value)
+{
+	if (tracked.known && tracked.value == value) {
+		state.counters.elided++;
+		return false;
+	}
+	tracked.value = value;
+	tracked.known = true;
+	state.counters.issued++;
+	return true;
+}
+
+static int IndexOf(const GLenum *values, int count, GLenum value)
+{
+	for (int i = 0; i < count; i++) {
+		if (values[i] == value) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void CachedUseProgram(GLuint program)
+{
+	if (Update(state.program, program)) {
+		glUseProgram(program);
+	}
+}
+
+void CachedBindVertexArray(GLuint vertexArray)
+{
+	if (Update(state.vertexArray, vertexArray)) {
+		glBindVertexArray(vertexArray);
+	}
+}
+
+void CachedBindBuffer(GLenum target, GLuint buffer)
+{
+	int index = IndexOf(bufferTargets, bufferTargetCount, target);
+	if (index < 0) {
+		state.counters.issued++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (Update(state.buffers[index], buffer)) {
+		glBindBuffer(target, buffer);
+	}
+}
+
+void CachedBindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	// Indexed bindings are not tracked, only the generic one it changes
+	state.counters.issued++;
+	glBindBufferBase(target, index, buffer);
+	int generic = IndexOf(bufferTargets, bufferTargetCount, target);
+	if (generic >= 0) {
+		state.buffers[generic].value = buffer;
+		state.buffers[generic].known = true;
+	}
+}
+
+void CachedBindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	int index = IndexOf(textureTargets, textureTargetCount, target);
+	if (unit >= (GLuint)maxTextureUnits || index < 0) {
+		state.counters.issued += 2;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		state.activeTexture.value = unit;
+		state.activeTexture.known = true;
+		return;
+	}
+
+	TrackedValue &binding = state.textures[unit][index];
+	if (binding.known && binding.value == texture) {
+		state.counters.elided++;
+		return;
+	}
+	if (Update(state.activeTexture, unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+	Update(binding, texture);
+	glBindTexture(target, texture);
+}
+
+void CachedEnable(GLenum capability, bool enabled)
+{
+	int index = IndexOf(capabilities, capabilityCount, capability);
+	if (index >= 0 && !Update(state.capabilities[index], enabled ? 1 : 0)) {
+		return;
+	}
+	if (index < 0) {
+		state.counters.issued++;
+	}
+	if (enabled) {
+		glEnable(capability);
+	}
+	else {
+		glDisable(capability);
+	}
+}
+
+void CachedDepthFunc(GLenum func)
+{
+	if (Update(state.depthFunc, func)) {
+		glDepthFunc(func);
+	}
+}
+
+void CachedDepthMask(GLboolean mask)
+{
+	if (Update(state.depthMask, mask)) {
+		glDepthMask(mask);
+	}
+}
+
+void CachedCullFace(GLenum mode)
+{
+	if (Update(state.cullFace, mode)) {
+		glCullFace(mode);
+	}
+}
+
+static void Forget(TrackedValue &tracked, GLuint name)
+{
+	if (tracked.known && tracked.value == name) {
+		tracked.known = false;
+	}
+}
+
+void CachedDeleteProgram(GLuint program)
+{
+	Forget(state.program, program);
+	glDeleteProgram(program);
+}
+
+void CachedDeleteVertexArray(GLuint vertexArray)
+{
+	Forget(state.vertexArray, vertexArray);
+	glDeleteVertexArrays(1, &vertexArray);
+}
+
+void CachedDeleteBuffer(GLuint buffer)
+{
+	for (int i = 0; i < bufferTargetCount; i++) {
+		Forget(state.buffers[i], buffer);
+	}
+	glDeleteBuffers(1, &buffer);
+}
+
+void CachedDeleteTexture(GLuint texture)
+{
+	for (int unit = 0; unit < maxTextureUnits; unit++) {
+		for (int i = 0; i < textureTargetCount; i++) {
+			Forget(state.textures[unit][i], texture);
+		}
+	}
+	glDeleteTextures(1, &texture);
+}
+
+void InvalidateGLState()
+{
+	GLStateCounters counters = state.counters;
+	memset(&state, 0, sizeof(state));
+	state.counters = counters;
+}
+
+GLStateCounters TakeGLStateCounters()
+{
+	GLStateCounters counters = state.counters;
+	state.counters.issued = 0;
+	state.counters.elided = 0;
+	return counters;
+}
@@ -0,0 +1,49 @@
+#ifndef _GL_STATE_H_
+#define _GL_STATE_H_
+
+#include <glad/gl.h>
+
+// Shadow copy of the GL binding and fixed-function state on the render
+// thread. Each Cached* call is forwarded to GL only when it changes the
+// state; otherwise it is counted as elided. State starts out unknown, so the
+// first call of each kind is always issued.
+
+struct GLStateCounters {
+	int issued;
+	int elided;
+};
+
+void CachedUseProgram(GLuint program);
+
+void CachedBindVertexArray(GLuint vertexArray);
+
+// GL_ELEMENT_ARRAY_BUFFER belongs to the bound VAO and is always issued
+void CachedBindBuffer(GLenum target, GLuint buffer);
+
+// Also moves the generic binding of target, like glBindBufferBase does
+void CachedBindBufferBase(GLenum target, GLuint index, GLuint buffer);
+
+// Selects the unit with glActiveTexture when needed
+void CachedBindTexture(GLuint unit, GLenum target, GLuint texture);
+
+void CachedEnable(GLenum capability, bool enabled);
+
+void CachedDepthFunc(GLenum func);
+
+void CachedDepthMask(GLboolean mask);
+
+void CachedCullFace(GLenum mode);
+
+// Delete through these so a recycled name is never mistaken for the bound one
+void CachedDeleteProgram(GLuint program);
+void CachedDeleteVertexArray(GLuint vertexArray);
+void CachedDeleteBuffer(GLuint buffer);
+void CachedDeleteTexture(GLuint texture);
+
+// Forget everything, e.g. after code outside the wrapper touched GL state
+void InvalidateGLState();
+
+// Counters since the previous call, reset on return. Call once per frame.
+GLStateCounters TakeGLStateCounters();
+
+#endif
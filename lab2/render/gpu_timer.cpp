@@ -0,0 +1,87 @@
+#include "gpu_timer.h"
+
+void GpuTimerRing::create(size_t slotCount)
+{
+	queries.resize(slotCount * 2);
+	tags.assign(slotCount, -1);
+	ended.assign(slotCount, 0);
+	glGenQueries((GLsizei)queries.size(), &queries[0]);
+	first = 0;
+	count = 0;
+}
+
+void GpuTimerRing::release()
+{
+	if (!queries.empty()) {
+		glDeleteQueries((GLsizei)queries.size(), &queries[0]);
+	}
+	queries.clear();
+	tags.clear();
+	ended.clear();
+	finished.clear();
+	first = 0;
+	count = 0;
+}
+
+size_t GpuTimerRing::begin(int tag)
+{
+	size_t slotCount = tags.size();
+	if (count == slotCount && !readOldest(true)) {
+		return noSlot;
+	}
+	size_t slot = (first + count) % slotCount;
+	tags[slot] = tag;
+	ended[slot] = 0;
+	glQueryCounter(queries[slot * 2], GL_TIMESTAMP);
+	count++;
+	return slot;
+}
+
+void GpuTimerRing::end(size_t slot)
+{
+	if (slot == noSlot) {
+		return;
+	}
+	glQueryCounter(queries[slot * 2 + 1], GL_TIMESTAMP);
+	ended[slot] = 1;
+}
+
+bool GpuTimerRing::readOldest(bool wait)
+{
+	// Results come out in begin order, an open outer timer holds back the rest
+	if (count == 0 || !ended[first]) {
+		return false;
+	}
+	GLuint endQuery = queries[first * 2 + 1];
+	if (!wait) {
+		GLint available = 0;
+		glGetQueryObjectiv(endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			return false;
+		}
+	}
+
+	// The end timestamp is available last, so the begin one is ready too
+	GLuint64 beginTime = 0, endTime = 0;
+	glGetQueryObjectui64v(queries[first * 2], GL_QUERY_RESULT, &beginTime);
+	glGetQueryObjectui64v(endQuery, GL_QUERY_RESULT, &endTime);
+
+	GpuTimerResult result;
+	result.tag = tags[first];
+	result.beginTime = beginTime;
+	result.milliseconds = endTime > beginTime ? (endTime - beginTime) * 1e-6 : 0.0;
+	finished.push_back(result);
+
+	tags[first] = -1;
+	first = (first + 1) % tags.size();
+	count--;
+	return true;
+}
+
+void GpuTimerRing::collect(std::vector<GpuTimerResult> &results, bool wait)
+{
+	while (readOldest(wait)) {
+	}
+	results.insert(results.end(), finished.begin(), finished.end());
+	finished.clear();
+}
@@ -0,0 +1,45 @@
+#ifndef _GPU_TIMER_H_
+#define _GPU_TIMER_H_
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <vector>
+
+struct GpuTimerResult {
+	int tag;
+	GLuint64 beginTime;		// GL_TIMESTAMP clock, nanoseconds
+	double milliseconds;
+};
+
+// Ring of GL_TIMESTAMP query pairs. Results are read a few frames late so
+// timing never stalls the pipeline; only a full ring waits for its oldest
+// entry. Timestamps rather than GL_TIME_ELAPSED, so timers can nest.
+struct GpuTimerRing {
+	std::vector<GLuint> queries;		// Begin and end timestamp per slot
+	std::vector<int> tags;
+	std::vector<char> ended;
+	std::vector<GpuTimerResult> finished;
+	size_t first;
+	size_t count;
+
+	GpuTimerRing() : first(0), count(0) {}
+
+	void create(size_t slotCount);
+	void release();
+
+	// Brackets the GL commands to time; tag identifies the result. begin
+	// returns the slot to pass to end, or noSlot when the ring is full of
+	// timers that are still open (the timer is then dropped).
+	static const size_t noSlot = (size_t)-1;
+	size_t begin(int tag);
+	void end(size_t slot);
+
+	// Moves finished timings to results in submission order. wait blocks
+	// until every pending timer is done, e.g. at the end of a run.
+	void collect(std::vector<GpuTimerResult> &results, bool wait);
+
+private:
+	bool readOldest(bool wait);
+};
+
+#endif
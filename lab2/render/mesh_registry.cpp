@@ -0,0 +1,136 @@
+#include "mesh_registry.h"
+
+#include "gl_state.h"
+#include "upload_scheduler.h"
+
+#include <profile/frame_stats.h>
+#include <profile/profiler.h>
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
+struct CachedMesh {
+	GpuMesh mesh;
+	std::string path;
+	int refCount;
+};
+
+// The render thread owns the GL objects, the mutex only lets workers query.
+// std::map nodes never move, so the GpuMesh pointers handed out stay valid.
+static std::mutex meshRegistryMutex;
+static std::map<std::string, CachedMesh> meshRegistry;
+static std::map<const GpuMesh *, std::string> meshKeys;
+
+static std::string MeshKey(const char *obj_file_path, VertexColorFunc colors)
+{
+	char suffix[32];
+	sprintf(suffix, "|%p", (void *)colors);
+	return std::string(obj_file_path) + suffix;
+}
+
+static void UploadMesh(const MeshData &source, VertexColorFunc colors, GpuMesh &mesh)
+{
+	size_t vertexCount = source.vertexCount;
+	size_t stride = source.vertexStride;
+
+	std::vector<GLfloat> vertexColors(vertexCount * 3, 1.0f);
+	if (colors) {
+		colors(vertexCount, vertexColors.data());
+	}
+	mesh.boundsMin = glm::vec3(source.boundsMin[0], source.boundsMin[1], source.boundsMin[2]);
+	mesh.boundsMax = glm::vec3(source.boundsMax[0], source.boundsMax[1], source.boundsMax[2]);
+
+	glGenVertexArrays(1, &mesh.vertexArrayID);
+	CachedBindVertexArray(mesh.vertexArrayID);
+
+	// Attribute state lives in the VAO, users only bind it
+	glGenBuffers(1, &mesh.vertexBufferID);
+	CachedBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBufferID);
+	glBufferData(GL_ARRAY_BUFFER, vertexCount * stride * sizeof(GLfloat), source.vertexData, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride * sizeof(GLfloat), BUFFER_OFFSET(0));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride * sizeof(GLfloat), BUFFER_OFFSET(3 * sizeof(GLfloat)));
+
+	glGenBuffers(1, &mesh.colorBufferID);
+	CachedBindBuffer(GL_ARRAY_BUFFER, mesh.colorBufferID);
+	glBufferData(GL_ARRAY_BUFFER, vertexColors.size() * sizeof(GLfloat), vertexColors.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), BUFFER_OFFSET(0));
+
+	glGenBuffers(1, &mesh.indexBufferID);
+	CachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBufferID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, source.indexCount * sizeof(GLuint), source.indices, GL_STATIC_DRAW);
+	mesh.indexCount = (GLsizei)source.indexCount;
+	NoteUploadBytes((vertexCount * stride + vertexColors.size()) * sizeof(GLfloat) + source.indexCount * sizeof(GLuint));
+
+	CachedBindVertexArray(0);
+}
+
+const GpuMesh *AcquireMesh(const char *obj_file_path, VertexColorFunc colors, const MeshData *mesh)
+{
+	PROFILE_SCOPE("AcquireMesh");
+	std::string key = MeshKey(obj_file_path, colors);
+	{
+		std::lock_guard<std::mutex> lock(meshRegistryMutex);
+		std::map<std::string, CachedMesh>::iterator it = meshRegistry.find(key);
+		if (it != meshRegistry.end()) {
+			it->second.refCount++;
+			return &it->second.mesh;
+		}
+	}
+
+	NoteFrameEvent(FrameEventAssetLoad);
+	MeshData loaded;
+	if (!mesh || mesh->empty()) {
+		LoadMesh(obj_file_path, loaded);
+		mesh = &loaded;
+	}
+
+	CachedMesh cached;
+	UploadMesh(*mesh, colors, cached.mesh);
+	cached.path = obj_file_path;
+	cached.refCount = 1;
+
+	std::lock_guard<std::mutex> lock(meshRegistryMutex);
+	CachedMesh &stored = meshRegistry[key];
+	stored = cached;
+	meshKeys[&stored.mesh] = key;
+	return &stored.mesh;
+}
+
+void ReleaseMesh(const GpuMesh *mesh)
+{
+	std::lock_guard<std::mutex> lock(meshRegistryMutex);
+	std::map<const GpuMesh *, std::string>::iterator key = meshKeys.find(mesh);
+	if (key == meshKeys.end()) {
+		return;
+	}
+
+	CachedMesh &cached = meshRegistry[key->second];
+	if (--cached.refCount > 0) {
+		return;
+	}
+	CachedDeleteBuffer(cached.mesh.vertexBufferID);
+	CachedDeleteBuffer(cached.mesh.colorBufferID);
+	CachedDeleteBuffer(cached.mesh.indexBufferID);
+	CachedDeleteVertexArray(cached.mesh.vertexArrayID);
+	meshRegistry.erase(key->second);
+	meshKeys.erase(key);
+}
+
+bool IsMeshCached(const char *obj_file_path)
+{
+	std::lock_guard<std::mutex> lock(meshRegistryMutex);
+	for (std::map<std::string, CachedMesh>::const_iterator it = meshRegistry.begin(); it != meshRegistry.end(); ++it) {
+		if (it->second.path == obj_file_path) {
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,37 @@
+#ifndef _MESH_REGISTRY_H_
+#define _MESH_REGISTRY_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+
+#include <asset/mesh_cache.h>
+
+// Writes three color floats per vertex for vertexCount vertices
+typedef void (*VertexColorFunc)(size_t vertexCount, GLfloat *colors);
+
+// One uploaded mesh: the vertex buffer in the mesh cache layout (position at
+// location 0, uv at 2), a color buffer (location 1), an index buffer, the VAO
+// that binds them and the object space bounds. Owned by the registry.
+struct GpuMesh {
+	GLuint vertexArrayID;
+	GLuint vertexBufferID;
+	GLuint colorBufferID;
+	GLuint indexBufferID;
+	GLsizei indexCount;
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+};
+
+// Shared GPU mesh for an OBJ path and color function, uploaded only by the
+// first user. Pass the already loaded mesh when there is one; otherwise the
+// file is loaded here. Its blocks go to glBufferData as they are, straight
+// from the mapped cache when it was current. Pair with ReleaseMesh.
+const GpuMesh *AcquireMesh(const char *obj_file_path, VertexColorFunc colors, const MeshData *mesh = NULL);
+
+void ReleaseMesh(const GpuMesh *mesh);
+
+// Thread-safe, lets tile workers skip parsing meshes that are already resident
+bool IsMeshCached(const char *obj_file_path);
+
+#endif
@@ -0,0 +1,61 @@
+#include "offscreen_target.h"
+
+#include <stb_image_write.h>
+#include <iostream>
+#include <vector>
+
+bool CreateOffscreenTarget(int width, int height, OffscreenTarget &target)
+{
+	target.width = width;
+	target.height = height;
+
+	// Renderbuffers, nothing samples the result
+	glGenRenderbuffers(1, &target.colorBufferID);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.colorBufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &target.depthBufferID);
+	glBindRenderbuffer(GL_RENDERBUFFER, target.depthBufferID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &target.framebufferID);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebufferID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.colorBufferID);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depthBufferID);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Offscreen framebuffer incomplete: 0x" << std::hex << status << std::dec << std::endl;
+		ReleaseOffscreenTarget(target);
+		return false;
+	}
+	glViewport(0, 0, width, height);
+	return true;
+}
+
+void ReleaseOffscreenTarget(OffscreenTarget &target)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &target.framebufferID);
+	glDeleteRenderbuffers(1, &target.colorBufferID);
+	glDeleteRenderbuffers(1, &target.depthBufferID);
+	target = OffscreenTarget();
+}
+
+bool SaveOffscreenTarget(const OffscreenTarget &target, const char *png_file_path)
+{
+	std::vector<unsigned char> pixels((size_t)target.width * target.height * 3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, target.framebufferID);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, target.width, target.height, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+	// GL rows start at the bottom
+	stbi_flip_vertically_on_write(1);
+	int written = stbi_write_png(png_file_path, target.width, target.height, 3, &pixels[0], target.width * 3);
+	stbi_flip_vertically_on_write(0);
+	if (!written) {
+		std::cerr << "Failed to write " << png_file_path << std::endl;
+		return false;
+	}
+	return true;
+}
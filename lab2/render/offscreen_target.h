@@ -0,0 +1,25 @@
+#ifndef _OFFSCREEN_TARGET_H_
+#define _OFFSCREEN_TARGET_H_
+
+#include <glad/gl.h>
+
+// Color and depth framebuffer for rendering without a visible window
+struct OffscreenTarget {
+	GLuint framebufferID;
+	GLuint colorBufferID;
+	GLuint depthBufferID;
+	int width;
+	int height;
+
+	OffscreenTarget() : framebufferID(0), colorBufferID(0), depthBufferID(0), width(0), height(0) {}
+};
+
+// Creates the framebuffer and leaves it bound with a matching viewport
+bool CreateOffscreenTarget(int width, int height, OffscreenTarget &target);
+
+void ReleaseOffscreenTarget(OffscreenTarget &target);
+
+// Reads back the color buffer and writes it as an RGB PNG
+bool SaveOffscreenTarget(const OffscreenTarget &target, const char *png_file_path);
+
+#endif
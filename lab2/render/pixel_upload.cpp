@@ -0,0 +1,116 @@
+#include "pixel_upload.h"
+#include "gl_state.h"
+#include "upload_scheduler.h"
+
+#include <profile/profiler.h>
+
+#include <cstring>
+#include <vector>
+
+struct PixelUploadBuffer {
+	GLuint bufferID;
+	GLsync fence;
+	size_t capacity;
+};
+
+static std::vector<PixelUploadBuffer> pixelUploadBuffers;
+static size_t nextPixelUploadBuffer = 0;
+static unsigned pixelUploadStalls = 0;
+
+void InitPixelUploadRing(int bufferCount)
+{
+	pixelUploadBuffers.resize(bufferCount);
+	for (int i = 0; i < bufferCount; i++) {
+		glGenBuffers(1, &pixelUploadBuffers[i].bufferID);
+		pixelUploadBuffers[i].fence = 0;
+		pixelUploadBuffers[i].capacity = 0;
+	}
+	nextPixelUploadBuffer = 0;
+}
+
+void ReleasePixelUploadRing()
+{
+	for (size_t i = 0; i < pixelUploadBuffers.size(); i++) {
+		if (pixelUploadBuffers[i].fence) {
+			glDeleteSync(pixelUploadBuffers[i].fence);
+		}
+		CachedDeleteBuffer(pixelUploadBuffers[i].bufferID);
+	}
+	pixelUploadBuffers.clear();
+}
+
+// Fills the next buffer and leaves it bound to GL_PIXEL_UNPACK_BUFFER.
+// Returns what to pass as the pixel pointer: an offset into the buffer, or
+// pixels itself when there is no ring or the copy failed.
+static const void *StagePixels(const void *pixels, size_t bytes)
+{
+	NoteUploadBytes(bytes);
+	if (pixelUploadBuffers.empty()) {
+		return pixels;
+	}
+	PROFILE_SCOPE("StagePixels");
+	PixelUploadBuffer &buffer = pixelUploadBuffers[nextPixelUploadBuffer];
+	nextPixelUploadBuffer = (nextPixelUploadBuffer + 1) % pixelUploadBuffers.size();
+
+	if (buffer.fence) {
+		if (glClientWaitSync(buffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+			pixelUploadStalls++;
+			glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(1000000000));
+		}
+		glDeleteSync(buffer.fence);
+		buffer.fence = 0;
+	}
+
+	CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.bufferID);
+	if (bytes > buffer.capacity) {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+		buffer.capacity = bytes;
+	}
+
+	// The fence has passed, so nothing reads the buffer any more
+	void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (!mapped) {
+		CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return pixels;
+	}
+	std::memcpy(mapped, pixels, bytes);
+	if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+		CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return pixels;
+	}
+	return NULL;
+}
+
+// Fences the buffer the upload read from and unbinds it, so later uploads
+// from client memory are not taken as buffer offsets
+static void FinishStaging(const void *source)
+{
+	if (source != NULL || pixelUploadBuffers.empty()) {
+		return;
+	}
+	size_t used = (nextPixelUploadBuffer + pixelUploadBuffers.size() - 1) % pixelUploadBuffers.size();
+	pixelUploadBuffers[used].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	CachedBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void StagedTexSubImage2D(GLenum target, GLint level, GLsizei width, GLsizei height, GLenum format, GLenum type,
+	const void *pixels, size_t bytes)
+{
+	const void *source = StagePixels(pixels, bytes);
+	glTexSubImage2D(target, level, 0, 0, width, height, format, type, source);
+	FinishStaging(source);
+}
+
+void StagedTexSubImage3D(GLenum target, GLint level, GLint layer, GLsizei width, GLsizei height, GLenum format,
+	GLenum type, const void *pixels, size_t bytes)
+{
+	const void *source = StagePixels(pixels, bytes);
+	glTexSubImage3D(target, level, 0, 0, layer, width, height, 1, format, type, source);
+	FinishStaging(source);
+}
+
+unsigned PixelUploadStalls()
+{
+	return pixelUploadStalls;
+}
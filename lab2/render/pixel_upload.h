@@ -0,0 +1,27 @@
+#ifndef _PIXEL_UPLOAD_H_
+#define _PIXEL_UPLOAD_H_
+
+#include <glad/gl.h>
+#include <cstddef>
+
+// Ring of pixel unpack buffers that texture uploads are staged through. The
+// pixels are copied into the next buffer and glTexSubImage* sources them
+// from there, so the call returns without waiting for the transfer. A fence
+// per buffer keeps it from being refilled while the GPU still reads it.
+// Buffers grow to the largest image staged through them.
+void InitPixelUploadRing(int bufferCount);
+
+void ReleasePixelUploadRing();
+
+// glTexSubImage2D / glTexSubImage3D of one level or layer of tightly packed
+// pixels. Before InitPixelUploadRing the pixels go straight from memory.
+void StagedTexSubImage2D(GLenum target, GLint level, GLsizei width, GLsizei height, GLenum format, GLenum type,
+	const void *pixels, size_t bytes);
+
+void StagedTexSubImage3D(GLenum target, GLint level, GLint layer, GLsizei width, GLsizei height, GLenum format,
+	GLenum type, const void *pixels, size_t bytes);
+
+// Uploads that found their buffer still in use and had to wait for it
+unsigned PixelUploadStalls();
+
+#endif
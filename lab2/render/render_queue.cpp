@@ -0,0 +1,129 @@
+#include "render_queue.h"
+#include "gl_state.h"
+
+#include <cstring>
+
+static unsigned int DepthBits(float depth)
+{
+	// Non-negative IEEE floats sort like their bit patterns
+	if (!(depth > 0.0f)) {
+		return 0;
+	}
+	unsigned int bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return bits;
+}
+
+RenderQueue::RenderQueue()
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+void RenderQueue::submit(const DrawPacket &packet, RenderPass pass, float depth)
+{
+	unsigned int depthBits = DepthBits(depth);
+	if (pass == RenderPassTransparent) {
+		depthBits = ~depthBits;
+	}
+
+	unsigned long long key = 0;
+	key |= (unsigned long long)(pass & 0xF) << 60;
+	key |= (unsigned long long)(packet.programID & 0xFFF) << 48;
+	key |= (unsigned long long)(packet.textureID & 0xFFFF) << 32;
+	key |= depthBits;
+
+	packets.push_back(packet);
+	keys.push_back(key);
+}
+
+void RenderQueue::sort()
+{
+	size_t count = keys.size();
+	order.resize(count);
+	scratch.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		order[i] = (unsigned int)i;
+	}
+
+	// LSD radix sort of the packet indices, one byte of the key per pass.
+	// Passes where every key has the same byte (usually pass and the high
+	// program bits) are skipped.
+	for (int shift = 0; shift < 64 && count > 1; shift += 8) {
+		size_t histogram[256];
+		memset(histogram, 0, sizeof(histogram));
+		for (size_t i = 0; i < count; i++) {
+			histogram[(keys[order[i]] >> shift) & 0xFF]++;
+		}
+		if (histogram[(keys[order[0]] >> shift) & 0xFF] == count) {
+			continue;
+		}
+
+		size_t offset = 0;
+		for (int digit = 0; digit < 256; digit++) {
+			size_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+		for (size_t i = 0; i < count; i++) {
+			scratch[histogram[(keys[order[i]] >> shift) & 0xFF]++] = order[i];
+		}
+		order.swap(scratch);
+	}
+}
+
+void RenderQueue::execute()
+{
+	GLuint currentProgram = 0;
+	GLuint currentVertexArray = 0;
+	GLenum currentTarget = 0;
+	GLuint currentTexture = 0;
+	bool first = true;
+
+	// The state cache elides binds that carry over from the previous frame
+	// or other render paths; the stats count changes between packets
+	for (size_t i = 0; i < order.size(); i++) {
+		const DrawPacket &packet = packets[order[i]];
+
+		if (first || packet.programID != currentProgram) {
+			CachedUseProgram(packet.programID);
+			if (packet.samplerLocation >= 0) {
+				glUniform1i(packet.samplerLocation, 0);
+			}
+			currentProgram = packet.programID;
+			stats.programChanges++;
+		}
+		if (first || packet.textureTarget != currentTarget || packet.textureID != currentTexture) {
+			CachedBindTexture(0, packet.textureTarget, packet.textureID);
+			currentTarget = packet.textureTarget;
+			currentTexture = packet.textureID;
+			stats.textureChanges++;
+		}
+		if (first || packet.vertexArrayID != currentVertexArray) {
+			CachedBindVertexArray(packet.vertexArrayID);
+			currentVertexArray = packet.vertexArrayID;
+			stats.vertexArrayChanges++;
+		}
+		first = false;
+
+		if (packet.matrixLocation >= 0) {
+			glUniformMatrix4fv(packet.matrixLocation, 1, GL_FALSE, &packet.matrix[0][0]);
+		}
+		const GLvoid *indices = (const GLvoid *)((const char *)NULL + packet.indexOffset);
+		if (packet.instanceCount == 1) {
+			glDrawElements(GL_TRIANGLES, packet.indexCount, GL_UNSIGNED_INT, indices);
+		}
+		else {
+			glDrawElementsInstanced(GL_TRIANGLES, packet.indexCount, GL_UNSIGNED_INT, indices, packet.instanceCount);
+		}
+		stats.draws++;
+	}
+}
+
+void RenderQueue::flush()
+{
+	memset(&stats, 0, sizeof(stats));
+	sort();
+	execute();
+	packets.clear();
+	keys.clear();
+}
@@ -0,0 +1,67 @@
+#ifndef _RENDER_QUEUE_H_
+#define _RENDER_QUEUE_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Passes execute in this order. Opaque draws go front to back within a
+// program and texture, transparent ones back to front.
+enum RenderPass {
+	RenderPassOpaque = 0,
+	RenderPassTransparent = 1,
+};
+
+// Everything needed to issue one indexed draw. The matrix is the only
+// per-draw constant (the model matrix); camera data comes from the
+// FrameConstants block. Instanced draws carry no matrix (location -1).
+struct DrawPacket {
+	GLuint programID;
+	GLint matrixLocation;
+	GLint samplerLocation;		// Set to texture unit 0 when the program is bound, -1 for none
+	GLenum textureTarget;
+	GLuint textureID;
+	GLuint vertexArrayID;
+	GLsizei indexCount;
+	GLsizeiptr indexOffset;		// In bytes into the element buffer, GL_UNSIGNED_INT indices
+	GLsizei instanceCount;		// 1 issues a plain glDrawElements
+	glm::mat4 matrix;
+
+	DrawPacket()
+		: programID(0), matrixLocation(-1), samplerLocation(-1), textureTarget(GL_TEXTURE_2D), textureID(0),
+		vertexArrayID(0), indexCount(0), indexOffset(0), instanceCount(1), matrix(1.0f) {}
+};
+
+struct RenderQueueStats {
+	int draws;
+	int programChanges;
+	int textureChanges;
+	int vertexArrayChanges;
+};
+
+// Collects the packets of a frame, sorts them by a 64-bit key and issues
+// them with redundant program, texture and VAO binds skipped.
+//
+// Key, most significant first: pass (4 bits), program (12), texture (16),
+// depth (32, the float bits of the view depth, inverted for transparent).
+struct RenderQueue {
+	std::vector<DrawPacket> packets;
+	std::vector<unsigned long long> keys;
+	std::vector<unsigned int> order;
+	std::vector<unsigned int> scratch;
+	RenderQueueStats stats;
+
+	RenderQueue();
+
+	// depth is the view space distance, e.g. w of the clip space position
+	void submit(const DrawPacket &packet, RenderPass pass, float depth);
+
+	// Sorts, executes and empties the queue; the stats describe this call
+	void flush();
+
+private:
+	void sort();
+	void execute();
+};
+
+#endif
@@ -1,49 +1,58 @@
 #include "shader.h"
+#include "gl_state.h"
+#include "frame_constants.h"
 
-#include <string> 
-#include <iostream> 
+#include <profile/frame_stats.h>
+#include <profile/profiler.h>
+
+#include <string>
+#include <iostream>
 #include <fstream>
-#include <sstream> 
+#include <sstream>
 #include <vector>
+#include <map>
+#include <cstdio>
+#include <cstring>
 
-GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_file_path)
+// GL 4.1 / ARB_get_program_binary, not part of the 3.3 core glad loader
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+typedef void (GLAD_API_PTR *GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (GLAD_API_PTR *ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void (GLAD_API_PTR *ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+static GetProgramBinaryProc getProgramBinary = NULL;
+static ProgramBinaryProc programBinary = NULL;
+static ProgramParameteriProc programParameteri = NULL;
+static std::string driverSignature;
+
+static bool ReadShaderFile(const char *file_path, std::string &code)
+{
+	std::ifstream stream(file_path, std::ios::in);
+	if (!stream.is_open()) {
+		return false;
+	}
+	std::stringstream sstr;
+	sstr << stream.rdbuf();
+	code = sstr.str();
+	return true;
+}
+
+static GLuint BuildProgram(const std::string &VertexShaderCode, const std::string &FragmentShaderCode,
+	const char *vertex_file_path, const char *fragment_file_path, bool retrievable)
 {
 	// Create the shaders
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
 	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if (VertexShaderStream.is_open())
-	{
-		std::stringstream sstr;
-		sstr << VertexShaderStream.rdbuf();
-		VertexShaderCode = sstr.str();
-		VertexShaderStream.close();
-	}
-	else
-	{
-		printf("Vertex shader not found %s.\n", vertex_file_path);
-		return 0;
-	}
-
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if (FragmentShaderStream.is_open())
-	{
-		std::stringstream sstr;
-		sstr << FragmentShaderStream.rdbuf();
-		FragmentShaderCode = sstr.str();
-		FragmentShaderStream.close();
-	}
-	else
-	{
-		printf("Fragment shader not found %s.\n", fragment_file_path);
-		return 0;
-	}
-
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 
@@ -56,7 +65,8 @@ GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_fi
 	// Check Vertex Shader
 	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
 	if (!Result) {
-		printf("Error compiling vertex shader : %s\n", vertex_file_path);
+		if (vertex_file_path) printf("Error compiling vertex shader : %s\n", vertex_file_path);
+		else printf("Error compiling vertex shader\n");
 		glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 		if (InfoLogLength > 0) {
 			std::vector<char> VertexShaderErrorMessage(InfoLogLength + 1);
@@ -75,7 +85,8 @@ GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_fi
 	// Check Fragment Shader
 	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
 	if (!Result) {
-		printf("Error compiling fragment shader : %s\n", fragment_file_path);
+		if (fragment_file_path) printf("Error compiling fragment shader : %s\n", fragment_file_path);
+		else printf("Error compiling fragment shader\n");
 		glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 		if (InfoLogLength > 0)
 		{
@@ -91,6 +102,9 @@ GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_fi
 	GLuint ProgramID = glCreateProgram();
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
+	if (retrievable && programParameteri) {
+		programParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
 	glLinkProgram(ProgramID);
 
 	// Check the program
@@ -116,80 +130,232 @@ GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_fi
 	return ProgramID;
 }
 
+GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_file_path)
+{
+	// Read the Vertex Shader code from the file
+	std::string VertexShaderCode;
+	if (!ReadShaderFile(vertex_file_path, VertexShaderCode))
+	{
+		printf("Vertex shader not found %s.\n", vertex_file_path);
+		return 0;
+	}
+
+	// Read the Fragment Shader code from the file
+	std::string FragmentShaderCode;
+	if (!ReadShaderFile(fragment_file_path, FragmentShaderCode))
+	{
+		printf("Fragment shader not found %s.\n", fragment_file_path);
+		return 0;
+	}
+
+	return BuildProgram(VertexShaderCode, FragmentShaderCode, vertex_file_path, fragment_file_path, false);
+}
+
 GLuint LoadShadersFromString(std::string VertexShaderCode, std::string FragmentShaderCode)
 {
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+	return BuildProgram(VertexShaderCode, FragmentShaderCode, NULL, NULL, false);
+}
 
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
+// ---------------------------------------------------------------------------
+// Program cache
+// ---------------------------------------------------------------------------
 
-	// Compile Vertex Shader
-	//printf("Compiling vertex shader\n");
-	char const *VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer, NULL);
-	glCompileShader(VertexShaderID);
+struct CachedProgram {
+	GLuint programID;
+	int refCount;
+};
 
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	if (!Result) {
-		printf("Error compiling vertex shader\n");
-		glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-		if (InfoLogLength > 0) {
-			std::vector<char> VertexShaderErrorMessage(InfoLogLength + 1);
-			glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-			printf("%s\n", &VertexShaderErrorMessage[0]);
-		}
-		return 0;
+static std::map<std::string, CachedProgram> programCache;
+static std::map<GLuint, std::string> programKeys;
+
+// 64-bit FNV-1a
+static unsigned long long HashString(const std::string &data, unsigned long long hash = 14695981039346656037ULL)
+{
+	for (size_t i = 0; i < data.size(); i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ULL;
 	}
+	return hash;
+}
 
-	// Compile Fragment Shader
-	//printf("Compiling fragment shader\n");
-	char const *FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer, NULL);
-	glCompileShader(FragmentShaderID);
+static std::string HashToHex(unsigned long long hash)
+{
+	char buffer[17];
+	sprintf(buffer, "%016llx", hash);
+	return buffer;
+}
 
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	if (!Result) {
-		printf("Error compiling fragment shader\n");
-		glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-		if (InfoLogLength > 0)
-		{
-			std::vector<char> FragmentShaderErrorMessage(InfoLogLength + 1);
-			glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-			printf("%s\n", &FragmentShaderErrorMessage[0]);
+void InitProgramBinaryCache(GLADloadfunc load)
+{
+	getProgramBinary = NULL;
+	programBinary = NULL;
+	programParameteri = NULL;
+
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool supported = major > 4 || (major == 4 && minor >= 1);
+	if (!supported) {
+		GLint extensionCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+		for (GLint i = 0; i < extensionCount && !supported; i++) {
+			const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+			supported = name && strcmp(name, "GL_ARB_get_program_binary") == 0;
 		}
+	}
+	if (!supported) {
+		return;
+	}
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	if (formatCount <= 0) {
+		return;
+	}
+
+	getProgramBinary = (GetProgramBinaryProc)load("glGetProgramBinary");
+	programBinary = (ProgramBinaryProc)load("glProgramBinary");
+	programParameteri = (ProgramParameteriProc)load("glProgramParameteri");
+	if (!getProgramBinary || !programBinary || !programParameteri) {
+		getProgramBinary = NULL;
+		programBinary = NULL;
+		programParameteri = NULL;
+		return;
+	}
+
+	// Binaries are only valid for the driver that produced them
+	const char *vendor = (const char *)glGetString(GL_VENDOR);
+	const char *renderer = (const char *)glGetString(GL_RENDERER);
+	const char *version = (const char *)glGetString(GL_VERSION);
+	driverSignature = std::string(vendor ? vendor : "") + "|" + (renderer ? renderer : "") + "|" + (version ? version : "");
+}
+
+static GLuint LoadProgramBinary(const std::string &binaryPath)
+{
+	FILE *file = fopen(binaryPath.c_str(), "rb");
+	if (!file) {
+		return 0;
+	}
+
+	GLenum format = 0;
+	GLint length = 0;
+	std::vector<char> binary;
+	bool ok = fread(&format, sizeof(format), 1, file) == 1 &&
+		fread(&length, sizeof(length), 1, file) == 1 && length > 0;
+	if (ok) {
+		binary.resize(length);
+		ok = fread(&binary[0], 1, length, file) == (size_t)length;
+	}
+	fclose(file);
+	if (!ok) {
 		return 0;
 	}
 
-	// Link the program
-	//printf("Linking program\n");
 	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
+	programBinary(ProgramID, format, &binary[0], length);
 
-	// Check the program
+	// The driver may reject a binary after an update, fall back to compiling
+	GLint Result = GL_FALSE;
 	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
 	if (!Result) {
-		printf("Error linking program\n");
-		glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-		if (InfoLogLength > 0)
-		{
-			std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
-			glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-			printf("%s\n", &ProgramErrorMessage[0]);
-		}
+		glDeleteProgram(ProgramID);
 		return 0;
 	}
+	return ProgramID;
+}
 
-	glDetachShader(ProgramID, VertexShaderID);
-	glDetachShader(ProgramID, FragmentShaderID);
+static void SaveProgramBinary(GLuint ProgramID, const std::string &binaryPath)
+{
+	GLint length = 0;
+	glGetProgramiv(ProgramID, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) {
+		return;
+	}
 
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	getProgramBinary(ProgramID, length, NULL, &format, &binary[0]);
+
+	FILE *file = fopen(binaryPath.c_str(), "wb");
+	if (!file) {
+		return;
+	}
+	fwrite(&format, sizeof(format), 1, file);
+	fwrite(&length, sizeof(length), 1, file);
+	fwrite(&binary[0], 1, length, file);
+	fclose(file);
+}
+
+GLuint AcquireProgram(const char *vertex_file_path, const char *fragment_file_path)
+{
+	PROFILE_SCOPE("AcquireProgram");
+
+	// A live program is shared without touching the files; they are only
+	// read again once every user released it
+	std::string key = std::string(vertex_file_path) + "|" + fragment_file_path;
+	std::map<std::string, CachedProgram>::iterator it = programCache.find(key);
+	if (it != programCache.end()) {
+		it->second.refCount++;
+		return it->second.programID;
+	}
+
+	NoteFrameEvent(FrameEventAssetLoad);
+
+	std::string VertexShaderCode, FragmentShaderCode;
+	if (!ReadShaderFile(vertex_file_path, VertexShaderCode))
+	{
+		printf("Vertex shader not found %s.\n", vertex_file_path);
+		return 0;
+	}
+	if (!ReadShaderFile(fragment_file_path, FragmentShaderCode))
+	{
+		printf("Fragment shader not found %s.\n", fragment_file_path);
+		return 0;
+	}
+	unsigned long long sourceHash = HashString(FragmentShaderCode, HashString(VertexShaderCode));
+
+	// Warm start: restore the linked program stored next to the vertex shader
+	GLuint ProgramID = 0;
+	std::string binaryPath;
+	if (programBinary) {
+		binaryPath = std::string(vertex_file_path) + "." + HashToHex(HashString(driverSignature, sourceHash)) + ".progbin";
+		ProgramID = LoadProgramBinary(binaryPath);
+	}
 
+	if (ProgramID == 0) {
+		ProgramID = BuildProgram(VertexShaderCode, FragmentShaderCode, vertex_file_path, fragment_file_path, programBinary != NULL);
+		if (ProgramID == 0) {
+			return 0;
+		}
+		if (programBinary) {
+			SaveProgramBinary(ProgramID, binaryPath);
+		}
+	}
+
+	BindFrameConstantsBlock(ProgramID);
+
+	CachedProgram cached;
+	cached.programID = ProgramID;
+	cached.refCount = 1;
+	programCache[key] = cached;
+	programKeys[ProgramID] = key;
 	return ProgramID;
 }
+
+void ReleaseProgram(GLuint programID)
+{
+	std::map<GLuint, std::string>::iterator key = programKeys.find(programID);
+	if (key == programKeys.end()) {
+		// Not owned by the cache
+		CachedDeleteProgram(programID);
+		return;
+	}
+
+	CachedProgram &cached = programCache[key->second];
+	if (--cached.refCount > 0) {
+		return;
+	}
+	CachedDeleteProgram(programID);
+	programCache.erase(key->second);
+	programKeys.erase(key);
+}
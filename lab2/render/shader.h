@@ -8,4 +8,17 @@ GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_fi
 
 GLuint LoadShadersFromString(std::string VertexShaderCode, std::string FragmentShaderCode);
 
+// Enables on-disk program binaries when the driver supports them (GL 4.1 or
+// ARB_get_program_binary). Call once after gladLoadGL.
+void InitProgramBinaryCache(GLADloadfunc load);
+
+// Shared program for a shader pair, keyed by paths. Only the first call
+// reads the sources and compiles them (or restores the binary cached under
+// their hash); pair with ReleaseProgram.
+// A FrameConstants uniform block in the program is attached to
+// frameConstantsBinding.
+GLuint AcquireProgram(const char *vertex_file_path, const char *fragment_file_path);
+
+void ReleaseProgram(GLuint programID);
+
 #endif
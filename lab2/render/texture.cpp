@@ -0,0 +1,216 @@
+#include "texture.h"
+#include "gl_state.h"
+#include "pixel_upload.h"
+
+#include <profile/frame_stats.h>
+#include <profile/profiler.h>
+
+#include <stb_image.h>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+bool DecodeImage(const char *texture_file_path, ImageData &image)
+{
+	PROFILE_SCOPE("DecodeImage");
+	int w, h, channels;
+	unsigned char* img = stbi_load(texture_file_path, &w, &h, &channels, 3);
+	if (!img) {
+		std::cout << "Failed to load texture " << texture_file_path << std::endl;
+		image = ImageData();
+		return false;
+	}
+
+	image.width = w;
+	image.height = h;
+	image.pixels.assign(img, img + w * h * 3);
+	stbi_image_free(img);
+	return true;
+}
+
+GLuint UploadTexture(const ImageData &image)
+{
+	PROFILE_SCOPE("UploadTexture");
+	GLuint texture;
+	glGenTextures(1, &texture);
+	CachedBindTexture(0, GL_TEXTURE_2D, texture);
+
+	// Set texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	// Set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	if (!image.pixels.empty()) {
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+		StagedTexSubImage2D(GL_TEXTURE_2D, 0, image.width, image.height, GL_RGB, GL_UNSIGNED_BYTE, image.pixels.data(),
+			image.pixels.size());
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	return texture;
+}
+
+GLuint LoadTextureTileBox(const char *texture_file_path)
+{
+	ImageData image;
+	DecodeImage(texture_file_path, image);
+	return UploadTexture(image);
+}
+
+// ---------------------------------------------------------------------------
+// Texture cache
+// ---------------------------------------------------------------------------
+
+struct CachedTexture {
+	GLuint textureID;
+	int refCount;
+};
+
+// The render thread owns the GL objects, the mutex only lets workers query
+static std::mutex textureCacheMutex;
+static std::map<std::string, CachedTexture> textureCache;
+static std::map<GLuint, std::string> textureKeys;
+
+static std::string TextureKey(const char *texture_file_path, const TextureSampler &sampler)
+{
+	char suffix[64];
+	sprintf(suffix, "|%x|%x|%x|%x", sampler.wrapS, sampler.wrapT, sampler.minFilter, sampler.magFilter);
+	return std::string(texture_file_path) + suffix;
+}
+
+GLuint AcquireTexture(const char *texture_file_path, const TextureSampler &sampler, const ImageData *image)
+{
+	std::string key = TextureKey(texture_file_path, sampler);
+	{
+		std::lock_guard<std::mutex> lock(textureCacheMutex);
+		std::map<std::string, CachedTexture>::iterator it = textureCache.find(key);
+		if (it != textureCache.end()) {
+			it->second.refCount++;
+			return it->second.textureID;
+		}
+	}
+
+	NoteFrameEvent(FrameEventAssetLoad);
+	ImageData decoded;
+	if (!image || image->pixels.empty()) {
+		DecodeImage(texture_file_path, decoded);
+		image = &decoded;
+	}
+
+	GLuint texture = UploadTexture(*image);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, sampler.wrapS);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, sampler.wrapT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+
+	std::lock_guard<std::mutex> lock(textureCacheMutex);
+	CachedTexture cached;
+	cached.textureID = texture;
+	cached.refCount = 1;
+	textureCache[key] = cached;
+	textureKeys[texture] = key;
+	return texture;
+}
+
+static std::string TextureArrayPath(const char *const *texture_file_paths, int layers)
+{
+	std::string path;
+	for (int i = 0; i < layers; i++) {
+		path += (i ? ";" : "");
+		path += texture_file_paths[i];
+	}
+	return path;
+}
+
+GLuint AcquireTextureArray(const char *const *texture_file_paths, int layers, const TextureSampler &sampler, const ImageData *images)
+{
+	std::string key = TextureKey(TextureArrayPath(texture_file_paths, layers).c_str(), sampler);
+	{
+		std::lock_guard<std::mutex> lock(textureCacheMutex);
+		std::map<std::string, CachedTexture>::iterator it = textureCache.find(key);
+		if (it != textureCache.end()) {
+			it->second.refCount++;
+			return it->second.textureID;
+		}
+	}
+
+	NoteFrameEvent(FrameEventAssetLoad);
+	std::vector<ImageData> decoded(layers);
+	std::vector<const ImageData *> layerImages(layers);
+	for (int i = 0; i < layers; i++) {
+		if (images && !images[i].pixels.empty()) {
+			layerImages[i] = &images[i];
+		}
+		else {
+			DecodeImage(texture_file_paths[i], decoded[i]);
+			layerImages[i] = &decoded[i];
+		}
+	}
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	CachedBindTexture(0, GL_TEXTURE_2D_ARRAY, texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, sampler.wrapS);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, sampler.wrapT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, sampler.minFilter);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, sampler.magFilter);
+
+	int width = layerImages[0]->width;
+	int height = layerImages[0]->height;
+	if (width > 0 && height > 0) {
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, width, height, layers, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+		for (int i = 0; i < layers; i++) {
+			const ImageData &image = *layerImages[i];
+			if (image.width != width || image.height != height) {
+				std::cout << "Texture array layer size mismatch " << texture_file_paths[i] << std::endl;
+				continue;
+			}
+			StagedTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, i, width, height, GL_RGB, GL_UNSIGNED_BYTE, image.pixels.data(),
+				image.pixels.size());
+		}
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	}
+
+	std::lock_guard<std::mutex> lock(textureCacheMutex);
+	CachedTexture cached;
+	cached.textureID = texture;
+	cached.refCount = 1;
+	textureCache[key] = cached;
+	textureKeys[texture] = key;
+	return texture;
+}
+
+void ReleaseTexture(GLuint textureID)
+{
+	std::lock_guard<std::mutex> lock(textureCacheMutex);
+	std::map<GLuint, std::string>::iterator key = textureKeys.find(textureID);
+	if (key == textureKeys.end()) {
+		// Not owned by the cache
+		CachedDeleteTexture(textureID);
+		return;
+	}
+
+	CachedTexture &cached = textureCache[key->second];
+	if (--cached.refCount > 0) {
+		return;
+	}
+	CachedDeleteTexture(textureID);
+	textureCache.erase(key->second);
+	textureKeys.erase(key);
+}
+
+bool IsTextureCached(const char *texture_file_path, const TextureSampler &sampler)
+{
+	std::lock_guard<std::mutex> lock(textureCacheMutex);
+	return textureCache.find(TextureKey(texture_file_path, sampler)) != textureCache.end();
+}
+
+bool IsTextureArrayCached(const char *const *texture_file_paths, int layers, const TextureSampler &sampler)
+{
+	return IsTextureCached(TextureArrayPath(texture_file_paths, layers).c_str(), sampler);
+}
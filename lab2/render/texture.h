@@ -0,0 +1,51 @@
+#ifndef _TEXTURE_H_
+#define _TEXTURE_H_
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <vector>
+
+// RGB pixels decoded on the CPU, kept apart from the GL upload so the
+// decode can run on a worker thread
+struct ImageData {
+	int width;
+	int height;
+	std::vector<unsigned char> pixels;
+
+	ImageData() : width(0), height(0) {}
+};
+
+bool DecodeImage(const char *texture_file_path, ImageData &image);
+
+GLuint UploadTexture(const ImageData &image);
+
+GLuint LoadTextureTileBox(const char *texture_file_path);
+
+// Sampler state baked into a texture, part of the texture cache key
+struct TextureSampler {
+	GLint wrapS;
+	GLint wrapT;
+	GLint minFilter;
+	GLint magFilter;
+
+	TextureSampler(GLint wrap = GL_REPEAT, GLint minFilter = GL_LINEAR_MIPMAP_LINEAR, GLint magFilter = GL_LINEAR)
+		: wrapS(wrap), wrapT(wrap), minFilter(minFilter), magFilter(magFilter) {}
+};
+
+// Shared texture for a path and sampler, decoded and uploaded only by the
+// first user. Pass the already decoded image when there is one; otherwise the
+// file is decoded here. Pair with ReleaseTexture.
+GLuint AcquireTexture(const char *texture_file_path, const TextureSampler &sampler, const ImageData *image = NULL);
+
+// Same as AcquireTexture for a GL_TEXTURE_2D_ARRAY with one layer per path.
+// All layers must have the same size as the first one.
+GLuint AcquireTextureArray(const char *const *texture_file_paths, int layers, const TextureSampler &sampler, const ImageData *images = NULL);
+
+void ReleaseTexture(GLuint textureID);
+
+// Thread-safe, lets tile workers skip decoding images that are already resident
+bool IsTextureCached(const char *texture_file_path, const TextureSampler &sampler);
+
+bool IsTextureArrayCached(const char *const *texture_file_paths, int layers, const TextureSampler &sampler);
+
+#endif
@@ -0,0 +1,107 @@
+#include "upload_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+static size_t uploadedBytes = 0;
+
+void NoteUploadBytes(size_t bytes)
+{
+	uploadedBytes += bytes;
+}
+
+size_t UploadedBytes()
+{
+	return uploadedBytes;
+}
+
+static double NowMilliseconds()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Nearer uploads first
+struct UploadDistanceLess {
+	glm::vec3 camera;
+
+	bool operator()(const UploadScheduler::Upload &a, const UploadScheduler::Upload &b) const
+	{
+		glm::vec3 da = a.position - camera, db = b.position - camera;
+		return glm::dot(da, da) < glm::dot(db, db);
+	}
+};
+
+UploadScheduler::UploadScheduler(double budgetMilliseconds, size_t budgetBytes)
+	: budgetMilliseconds(budgetMilliseconds), budgetBytes(budgetBytes), frameStart(0.0), bytesAtStart(0), steps(0),
+	unbounded(false)
+{
+}
+
+void UploadScheduler::add(int id, int stepCount, const glm::vec3 &position)
+{
+	Upload upload;
+	upload.id = id;
+	upload.step = 0;
+	upload.stepCount = stepCount;
+	upload.position = position;
+	pending.push_back(upload);
+}
+
+int UploadScheduler::remove(int id)
+{
+	for (size_t i = 0; i < pending.size(); i++) {
+		if (pending[i].id == id) {
+			int stepsRun = pending[i].step;
+			pending.erase(pending.begin() + i);
+			return stepsRun;
+		}
+	}
+	return -1;
+}
+
+void UploadScheduler::beginFrame(const glm::vec3 &camera, bool unbounded)
+{
+	frameStart = NowMilliseconds();
+	bytesAtStart = uploadedBytes;
+	steps = 0;
+	this->unbounded = unbounded;
+
+	// Stable, so an upload that already started stays ahead of its equals
+	UploadDistanceLess nearer;
+	nearer.camera = camera;
+	std::stable_sort(pending.begin(), pending.end(), nearer);
+}
+
+bool UploadScheduler::next(int &id, int &step)
+{
+	if (pending.empty()) {
+		return false;
+	}
+	if (steps > 0 && !unbounded) {
+		if (budgetMilliseconds > 0.0 && NowMilliseconds() - frameStart >= budgetMilliseconds) {
+			return false;
+		}
+		if (budgetBytes > 0 && frameBytes() >= budgetBytes) {
+			return false;
+		}
+	}
+	id = pending.front().id;
+	step = pending.front().step;
+	return true;
+}
+
+bool UploadScheduler::stepDone()
+{
+	steps++;
+	Upload &upload = pending.front();
+	if (++upload.step < upload.stepCount) {
+		return false;
+	}
+	pending.erase(pending.begin());
+	return true;
+}
+
+size_t UploadScheduler::frameBytes() const
+{
+	return uploadedBytes - bytesAtStart;
+}
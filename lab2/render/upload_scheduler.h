@@ -0,0 +1,62 @@
+#ifndef _UPLOAD_SCHEDULER_H_
+#define _UPLOAD_SCHEDULER_H_
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// Spreads GL uploads over frames on the render thread. An upload is split
+// into steps that the caller runs one at a time (e.g. one scene object of a
+// tile each). Every frame, steps of the upload nearest to the camera run
+// until the time or byte budget of the frame is spent. The first step of a
+// frame always runs, so a small budget slows uploads down but never stops
+// them.
+struct UploadScheduler {
+	struct Upload {
+		int id;
+		int step;			// Next step to run
+		int stepCount;
+		glm::vec3 position;
+	};
+
+	double budgetMilliseconds;	// 0 for no limit
+	size_t budgetBytes;			// 0 for no limit
+	std::vector<Upload> pending;
+
+	UploadScheduler(double budgetMilliseconds = 2.0, size_t budgetBytes = 8 << 20);
+
+	void add(int id, int stepCount, const glm::vec3 &position);
+
+	// Drops an upload before it finished. Returns the number of steps that
+	// already ran, so the caller can undo them, or -1 when id is not pending.
+	int remove(int id);
+
+	// Resets the budget and orders the uploads nearest to camera first.
+	// unbounded lifts the budget for this frame, e.g. before the first one.
+	void beginFrame(const glm::vec3 &camera, bool unbounded = false);
+
+	// The step to run next, false when the budget is spent or nothing is
+	// pending. Call stepDone after running it.
+	bool next(int &id, int &step);
+
+	// True when the step from next was the last of its upload, which is then
+	// removed
+	bool stepDone();
+
+	size_t frameBytes() const;
+	int frameSteps() const { return steps; }
+
+private:
+	double frameStart;
+	size_t bytesAtStart;
+	int steps;
+	bool unbounded;
+};
+
+// Counts bytes handed to GL for buffers and textures on the render thread,
+// the measure of the byte budget
+void NoteUploadBytes(size_t bytes);
+
+size_t UploadedBytes();
+
+#endif
@@ -5,16 +5,23 @@ in vec3 worldNormal;
 
 out vec3 finalColor;
 
-uniform vec3 lightPosition;
-uniform vec3 lightIntensity;
+// Camera and light data, updated once per frame (see render/frame_constants.h)
+layout(std140) uniform FrameConstants {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 cameraPosition;
+	vec4 lightPosition;
+	vec4 lightIntensity;
+};
 
 void main()
 {
 	// Lighting
-	vec3 lightDir = lightPosition - worldPosition;
+	vec3 lightDir = lightPosition.xyz - worldPosition;
 	float lightDist = dot(lightDir, lightDir);
 	lightDir = normalize(lightDir);
-	vec3 v = lightIntensity * clamp(dot(lightDir, worldNormal), 0.0, 1.0) / lightDist;
+	vec3 v = lightIntensity.xyz * clamp(dot(lightDir, worldNormal), 0.0, 1.0) / lightDist;
 
 	// Tone mapping
 	v = v / (1.0 + v);
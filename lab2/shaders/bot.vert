@@ -10,7 +10,17 @@ layout(location = 4) in vec4 a_weight;
 out vec3 worldPosition;
 out vec3 worldNormal;
 
-uniform mat4 MVP;
+// Camera and light data, updated once per frame (see render/frame_constants.h)
+layout(std140) uniform FrameConstants {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 cameraPosition;
+	vec4 lightPosition;
+	vec4 lightIntensity;
+};
+
+uniform mat4 model;
 
 uniform mat4 u_jointMat[25];
 
@@ -22,7 +32,7 @@ void main() {
         a_weight.z * u_jointMat[int(a_joint.z)] +
         a_weight.w * u_jointMat[int(a_joint.w)];
 
-    gl_Position = MVP * skinMat * vec4(vertexPosition, 1.0);
+    gl_Position = viewProjection * model * skinMat * vec4(vertexPosition, 1.0);
 
     // World-space geometry
     worldPosition = vertexPosition;
@@ -0,0 +1,14 @@
+#version 330 core
+
+in vec2 uv;
+flat in float facade;
+
+// One facade texture per layer
+uniform sampler2DArray textureSampler;
+
+out vec3 finalColor;
+
+void main()
+{
+	finalColor = texture(textureSampler, vec3(uv, facade)).rgb;
+}
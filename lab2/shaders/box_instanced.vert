@@ -0,0 +1,31 @@
+#version 330 core
+
+// Input
+layout(location = 0) in vec3 vertexPosition;
+layout(location = 2) in vec2 vertexUV;
+
+// Per-instance data, one entry per building
+layout(location = 3) in mat4 instanceModel;	// Occupies locations 3-6
+layout(location = 7) in float instanceFacade;
+
+// Output data, to be interpolated for each fragment
+out vec2 uv;
+flat out float facade;
+
+// Camera and light data, updated once per frame (see render/frame_constants.h)
+layout(std140) uniform FrameConstants {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 cameraPosition;
+	vec4 lightPosition;
+	vec4 lightIntensity;
+};
+
+void main() {
+    // Transform vertex
+    gl_Position = viewProjection * instanceModel * vec4(vertexPosition, 1);
+
+    uv = vertexUV;
+    facade = instanceFacade;
+}
@@ -4,14 +4,25 @@ layout (location = 1) in vec3 aColor;
 layout (location = 2) in vec2 aUV;
 
 
-uniform mat4 MVP;
+// Camera and light data, updated once per frame (see render/frame_constants.h)
+layout(std140) uniform FrameConstants {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 cameraPosition;
+	vec4 lightPosition;
+	vec4 lightIntensity;
+};
+
+// Per-object transform
+uniform mat4 model;
 
 out vec3 vertexColor;
 out vec2 UV;
 
 void main()
 {
-    gl_Position = MVP * vec4(aPos, 1.0);
+    gl_Position = viewProjection * model * vec4(aPos, 1.0);
 	vertexColor = aColor;
 	UV = aUV;
 }
\ No newline at end of file
@@ -10,12 +10,23 @@ out vec3 color;
 out vec2 uv; 
 
 
+// Camera and light data, updated once per frame (see render/frame_constants.h)
+layout(std140) uniform FrameConstants {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 cameraPosition;
+	vec4 lightPosition;
+	vec4 lightIntensity;
+};
+
 // Matrix for vertex transformation
-uniform mat4 MVP;
+uniform mat4 model;
 
 void main() {
     // Transform vertex
-    gl_Position =  MVP * vec4(vertexPosition, 1);
+    // The sky follows the camera, drop the translation of the view
+    gl_Position =  projection * mat4(mat3(view)) * model * vec4(vertexPosition, 1);
     
     // Pass vertex color to the fragment shader
     color = vertexColor;
@@ -0,0 +1,76 @@
+#include "tile.h"
+#include "tile_random.h"
+
+#include <profile/profiler.h>
+
+#include <cmath>
+#include <cstdio>
+
+// Random streams of a tile
+static const unsigned tileLayoutStream = 0;
+
+glm::ivec2 TileCoordinate(const glm::vec3 &offset)
+{
+	return glm::ivec2((int)std::floor(offset.x / tileSize + 0.5f), (int)std::floor(offset.z / tileSize + 0.5f));
+}
+
+void GenerateTile(const glm::vec3 &offset, TileData &tile)
+{
+	PROFILE_SCOPE("GenerateTile");
+	tile.offset = offset;
+	tile.coordinate = TileCoordinate(offset);
+	tile.buildings.clear();
+	TileRandom random(TileSeed(tile.coordinate.x, tile.coordinate.y, tileLayoutStream));
+
+	// Lay out the grid of buildings
+	for (int x = -500; x + 320 <= 1000; x += 320) {
+		for (int y = 180; y + 320 <= 1000; y += 320) {
+			int innerXMin = x + (320 - 150) / 2;
+			int innerXMax = innerXMin + 150;
+			int innerYMin = y + (320 - 150) / 2;
+			int innerYMax = innerYMin + 150;
+			float rotation = random.range(0, 110);
+			int randomX = random.range(innerXMin, innerXMax - 1);
+			int randomY = random.range(innerYMin, innerYMax - 1);
+			int cube = random.range(60, 100);
+
+			BuildingDesc b;
+			b.scale = glm::vec3(cube, cube, cube);
+			b.position = glm::vec3(randomX, -440 + (cube), randomY) + offset;
+			b.rotation = glm::vec3(0.0f, rotation, 0.0f);
+			b.facade = random.range(0, 3);
+			tile.buildings.push_back(b);
+		}
+	}
+
+	const char *paths[4];
+	for (int i = 0; i < 4; i++) {
+		char path[50];
+		sprintf(path, "../../../lab2/textures/facade%d.jpg", i + 1);
+		tile.facadePaths[i] = path;
+		paths[i] = tile.facadePaths[i].c_str();
+	}
+
+	// Buildings sample all four facades as layers of one texture array;
+	// island, cloud, surface and spire sample facade1 on its own
+	bool arrayCached = IsTextureArrayCached(paths, 4, buildingSampler);
+	for (int i = 0; i < 4; i++) {
+		bool needed = !arrayCached;
+		if (i == 0) {
+			needed = needed || !IsTextureCached(paths[i], terrainSampler) || !IsTextureCached(paths[i], surfaceSampler);
+		}
+		if (needed) {
+			DecodeImage(paths[i], tile.facades[i]);
+		}
+	}
+
+	// Geometry is shared between tiles, only load what is not on the GPU
+	const char *meshPaths[6] = { rockMeshPath, treeMeshPath, islandMeshPath, cloudMeshPath, surfaceMeshPath, spireMeshPath };
+	MeshData *meshes[6] = { &tile.rock, &tile.tree, &tile.island, &tile.cloud, &tile.surface, &tile.spire };
+	for (int i = 0; i < 6; i++) {
+		*meshes[i] = MeshData();
+		if (!IsMeshCached(meshPaths[i])) {
+			LoadMesh(meshPaths[i], *meshes[i]);
+		}
+	}
+}
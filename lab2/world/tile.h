@@ -0,0 +1,65 @@
+#ifndef _TILE_H_
+#define _TILE_H_
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include <render/mesh_registry.h>
+#include <render/texture.h>
+
+// Edge length of a square tile in world units; tiles are centred on
+// multiples of it
+const float tileSize = 6000.0f;
+
+// Samplers the scene objects use for the facade textures
+const TextureSampler buildingSampler(GL_REPEAT, GL_LINEAR, GL_LINEAR);
+const TextureSampler terrainSampler;	// Island, Cloud
+const TextureSampler surfaceSampler(GL_REPEAT, GL_NEAREST, GL_NEAREST);
+
+// OBJ assets placed in every tile
+const char *const rockMeshPath = "../../../lab2/rock.obj";
+const char *const treeMeshPath = "../../../lab2/tree.obj";
+const char *const islandMeshPath = "../../../lab2/test.obj";
+const char *const cloudMeshPath = "../../../lab2/cloud.obj";
+const char *const surfaceMeshPath = "../../../lab2/testsurface.obj";
+const char *const spireMeshPath = "../../../lab2/spire.obj";
+
+// Placement of one building inside a tile
+struct BuildingDesc {
+	glm::vec3 position;
+	glm::vec3 scale;
+	glm::vec3 rotation;
+	int facade;				// Index into TileData::facades, layer of the facade array
+};
+
+// Everything a Scene needs that does not touch OpenGL: building layout,
+// loaded meshes and decoded facade images
+struct TileData {
+	glm::vec3 offset;
+	glm::ivec2 coordinate;		// offset / tileSize, seeds the layout
+	std::vector<BuildingDesc> buildings;
+
+	// A mesh is left empty when it was already in the mesh registry at
+	// generation time
+	MeshData rock;
+	MeshData tree;
+	MeshData island;
+	MeshData cloud;
+	MeshData surface;
+	MeshData spire;
+
+	// facade1.jpg .. facade4.jpg. An image is left empty when every texture
+	// made from it was already in the texture cache at generation time.
+	std::string facadePaths[4];
+	ImageData facades[4];
+};
+
+// Integer coordinates of the tile centred at offset
+glm::ivec2 TileCoordinate(const glm::vec3 &offset);
+
+// Builds the CPU side of a tile, safe to call from any thread. The layout
+// is a function of the tile coordinates only, so it is the same every time.
+void GenerateTile(const glm::vec3 &offset, TileData &tile);
+
+#endif
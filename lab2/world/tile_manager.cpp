@@ -0,0 +1,245 @@
+#include "tile_manager.h"
+#include "tile.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+static std::pair<int, int> CoordinateKey(const glm::ivec2 &coordinate)
+{
+	return std::make_pair(coordinate.x, coordinate.y);
+}
+
+static int TileDistance(const glm::ivec2 &a, const glm::ivec2 &b)
+{
+	return std::max(std::abs(a.x - b.x), std::abs(a.y - b.y));
+}
+
+// Nearer tiles first, so the streamer builds the ones around the camera early
+struct RequestDistanceLess {
+	glm::ivec2 center;
+
+	bool operator()(const TileManager::Request &a, const TileManager::Request &b) const
+	{
+		glm::ivec2 da = a.coordinate - center, db = b.coordinate - center;
+		return da.x * da.x + da.y * da.y < db.x * db.x + db.y * db.y;
+	}
+};
+
+TileManager::TileManager(int radius, size_t cacheBudget)
+	: radius(radius), prefetchSeconds(2.0f), prefetchMinSpeed(50.0f), cacheBudget(cacheBudget), cachedBytes(0),
+	centered(false), center(0, 0)
+{
+	stats.hits = 0;
+	stats.misses = 0;
+	stats.evictions = 0;
+	stats.prefetches = 0;
+	stats.promotions = 0;
+	stats.cancellations = 0;
+}
+
+int TileManager::allocateSlot(const glm::ivec2 &coordinate, SlotState state)
+{
+	int slot;
+	if (!freeSlots.empty()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		slot = (int)slots.size();
+		slots.push_back(Slot());
+	}
+	slots[slot].coordinate = coordinate;
+	slots[slot].state = state;
+	slots[slot].bytes = 0;
+	slotsByCoordinate[CoordinateKey(coordinate)] = slot;
+	return slot;
+}
+
+void TileManager::freeSlot(int slot)
+{
+	slotsByCoordinate.erase(CoordinateKey(slots[slot].coordinate));
+	slots[slot].state = SlotFree;
+	slots[slot].bytes = 0;
+	freeSlots.push_back(slot);
+}
+
+void TileManager::evictOverBudget(std::vector<int> &released)
+{
+	while (cachedBytes > cacheBudget && !lru.empty()) {
+		int slot = lru.back();
+		lru.pop_back();
+		cachedBytes -= slots[slot].bytes;
+		released.push_back(slot);
+		freeSlot(slot);
+		stats.evictions++;
+	}
+}
+
+void TileManager::update(const glm::vec3 &camera, const glm::vec3 &velocity, std::vector<Request> &requests,
+	std::vector<int> &released, std::vector<int> &cancelled, std::vector<int> &promoted)
+{
+	glm::ivec2 cameraTile = TileCoordinate(camera);
+	if (!centered || cameraTile != center) {
+		recenter(cameraTile, requests, cancelled, promoted);
+	}
+	prefetch(camera, velocity, requests, cancelled);
+	evictOverBudget(released);
+}
+
+void TileManager::recenter(const glm::ivec2 &cameraTile, std::vector<Request> &requests, std::vector<int> &cancelled,
+	std::vector<int> &promoted)
+{
+	centered = true;
+	center = cameraTile;
+
+	// Tiles that left the square: ready ones are cached, pending ones dropped.
+	// Prefetches are left to prefetch().
+	for (size_t i = 0; i < slots.size(); i++) {
+		Slot &slot = slots[i];
+		if (slot.state != SlotResident && slot.state != SlotPending) {
+			continue;
+		}
+		if (TileDistance(slot.coordinate, center) <= radius) {
+			continue;
+		}
+		if (slot.state == SlotResident) {
+			slot.state = SlotCached;
+			lru.push_front((int)i);
+			cachedBytes += slot.bytes;
+		}
+		else {
+			cancelled.push_back((int)i);
+			freeSlot((int)i);
+			stats.cancellations++;
+		}
+	}
+
+	// Tiles that entered it: from the cache when possible
+	size_t firstRequest = requests.size();
+	for (int dx = -radius; dx <= radius; dx++) {
+		for (int dz = -radius; dz <= radius; dz++) {
+			glm::ivec2 coordinate = center + glm::ivec2(dx, dz);
+			std::map<std::pair<int, int>, int>::iterator it = slotsByCoordinate.find(CoordinateKey(coordinate));
+			if (it != slotsByCoordinate.end()) {
+				Slot &slot = slots[it->second];
+				if (slot.state == SlotCached) {
+					lru.remove(it->second);
+					cachedBytes -= slot.bytes;
+					slot.state = SlotResident;
+					stats.hits++;
+				}
+				else if (slot.state == SlotPrefetching) {
+					// Still generating, but no longer speculative
+					slot.state = SlotPending;
+					promoted.push_back(it->second);
+					stats.promotions++;
+				}
+				continue;
+			}
+
+			Request request;
+			request.slot = allocateSlot(coordinate, SlotPending);
+			request.coordinate = coordinate;
+			request.offset = glm::vec3(coordinate.x * tileSize, 0.0f, coordinate.y * tileSize);
+			request.speculative = false;
+			requests.push_back(request);
+			stats.misses++;
+		}
+	}
+	RequestDistanceLess nearer;
+	nearer.center = center;
+	std::sort(requests.begin() + firstRequest, requests.end(), nearer);
+}
+
+void TileManager::prefetch(const glm::vec3 &camera, const glm::vec3 &velocity, std::vector<Request> &requests,
+	std::vector<int> &cancelled)
+{
+	// A camera at rest keeps what it already prefetched
+	if (glm::length(glm::vec2(velocity.x, velocity.z)) < prefetchMinSpeed) {
+		return;
+	}
+
+	// One tile step towards where the camera will be, e.g. (1, 0) or (1, -1)
+	glm::ivec2 predicted = TileCoordinate(camera + velocity * prefetchSeconds) - center;
+	glm::ivec2 step(std::max(-1, std::min(1, predicted.x)), std::max(-1, std::min(1, predicted.y)));
+	glm::ivec2 ahead = center + step;
+	bool moving = step != glm::ivec2(0, 0);
+
+	// The square around the tile ahead, minus what is resident already
+	for (size_t i = 0; i < slots.size(); i++) {
+		if (slots[i].state == SlotPrefetching && (!moving || TileDistance(slots[i].coordinate, ahead) > radius)) {
+			cancelled.push_back((int)i);
+			freeSlot((int)i);
+			stats.cancellations++;
+		}
+	}
+	if (!moving) {
+		return;
+	}
+
+	size_t firstRequest = requests.size();
+	for (int dx = -radius; dx <= radius; dx++) {
+		for (int dz = -radius; dz <= radius; dz++) {
+			glm::ivec2 coordinate = ahead + glm::ivec2(dx, dz);
+			if (TileDistance(coordinate, center) <= radius ||
+				slotsByCoordinate.find(CoordinateKey(coordinate)) != slotsByCoordinate.end()) {
+				continue;
+			}
+
+			Request request;
+			request.slot = allocateSlot(coordinate, SlotPrefetching);
+			request.coordinate = coordinate;
+			request.offset = glm::vec3(coordinate.x * tileSize, 0.0f, coordinate.y * tileSize);
+			request.speculative = true;
+			requests.push_back(request);
+			stats.prefetches++;
+		}
+	}
+	RequestDistanceLess nearer;
+	nearer.center = center;
+	std::sort(requests.begin() + firstRequest, requests.end(), nearer);
+}
+
+bool TileManager::acceptTile(int slot, const glm::ivec2 &coordinate)
+{
+	return slot >= 0 && slot < (int)slots.size() &&
+		(slots[slot].state == SlotPending || slots[slot].state == SlotPrefetching) &&
+		slots[slot].coordinate == coordinate;
+}
+
+void TileManager::tileReady(int slot, size_t bytes)
+{
+	slots[slot].bytes = bytes;
+	if (slots[slot].state == SlotPrefetching) {
+		// Waits in the cache until the camera gets there
+		slots[slot].state = SlotCached;
+		lru.push_front(slot);
+		cachedBytes += bytes;
+	}
+	else {
+		slots[slot].state = SlotResident;
+	}
+}
+
+bool TileManager::isResident(int slot) const
+{
+	return slot >= 0 && slot < (int)slots.size() && slots[slot].state == SlotResident;
+}
+
+size_t TileManager::residentCount() const
+{
+	size_t count = 0;
+	for (size_t i = 0; i < slots.size(); i++) {
+		count += slots[i].state == SlotResident;
+	}
+	return count;
+}
+
+void TileManager::allocatedSlots(std::vector<int> &allocated) const
+{
+	for (size_t i = 0; i < slots.size(); i++) {
+		if (slots[i].state == SlotResident || slots[i].state == SlotCached) {
+			allocated.push_back((int)i);
+		}
+	}
+}
@@ -0,0 +1,104 @@
+#ifndef _TILE_MANAGER_H_
+#define _TILE_MANAGER_H_
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Decides which tiles exist around the camera. Tiles live in numbered
+// slots the caller owns (e.g. a vector of scenes); the manager only hands
+// out slot numbers and tells the caller what to generate and what to free.
+//
+// Every tile within radius tiles of the camera tile (a square of
+// 2 * radius + 1 tiles per side) is resident. A ready tile that leaves the
+// square keeps its slot and resources in an LRU cache, so coming back is a
+// hit instead of a regeneration. Cached tiles are freed oldest first once
+// their reported bytes exceed the cache budget.
+//
+// While the camera moves, the tiles that would become resident after the
+// next tile crossing in the direction of travel are prefetched. They land
+// in the cache, so the crossing itself is a hit. If the camera turns, the
+// prefetches that are no longer ahead of it are cancelled.
+struct TileManager {
+	enum SlotState {
+		SlotFree,
+		SlotPending,		// Requested, waiting for the generated tile
+		SlotPrefetching,	// Requested speculatively, goes to the cache when ready
+		SlotResident,
+		SlotCached
+	};
+
+	struct Slot {
+		glm::ivec2 coordinate;
+		SlotState state;
+		size_t bytes;
+	};
+
+	// A tile the caller should generate into a slot
+	struct Request {
+		int slot;
+		glm::ivec2 coordinate;
+		glm::vec3 offset;
+		bool speculative;
+	};
+
+	struct Stats {
+		unsigned hits;
+		unsigned misses;
+		unsigned evictions;
+		unsigned prefetches;
+		unsigned promotions;		// Prefetches still generating when they came into range
+		unsigned cancellations;
+	};
+
+	int radius;
+	float prefetchSeconds;		// How far ahead the camera position is predicted
+	float prefetchMinSpeed;		// Units per second; slower cameras prefetch nothing
+	size_t cacheBudget;
+	size_t cachedBytes;
+	bool centered;
+	glm::ivec2 center;
+	std::vector<Slot> slots;
+	std::vector<int> freeSlots;
+	std::map<std::pair<int, int>, int> slotsByCoordinate;
+	std::list<int> lru;			// Cached slots, most recently used first
+	Stats stats;
+
+	TileManager(int radius = 1, size_t cacheBudget = 16 << 20);
+
+	// Recentres on the tile under the camera and prefetches along velocity.
+	// Appends the tiles to generate, the slots whose resources the caller
+	// must free, the slots whose outstanding requests to cancel, and the
+	// slots whose prefetches are now required and should be promoted.
+	void update(const glm::vec3 &camera, const glm::vec3 &velocity, std::vector<Request> &requests,
+		std::vector<int> &released, std::vector<int> &cancelled, std::vector<int> &promoted);
+
+	// Call when the generated tile of a slot arrives. False when the slot was
+	// dropped or reassigned meanwhile; the tile is then stale and discarded.
+	bool acceptTile(int slot, const glm::ivec2 &coordinate);
+
+	// After the caller initialized the slot, with the memory it now holds
+	void tileReady(int slot, size_t bytes);
+
+	bool isResident(int slot) const;
+	size_t slotCount() const { return slots.size(); }
+	size_t residentCount() const;
+	size_t cachedCount() const { return lru.size(); }
+
+	// Every slot holding resources, for cleanup at exit
+	void allocatedSlots(std::vector<int> &allocated) const;
+
+private:
+	void recenter(const glm::ivec2 &cameraTile, std::vector<Request> &requests, std::vector<int> &cancelled,
+		std::vector<int> &promoted);
+	void prefetch(const glm::vec3 &camera, const glm::vec3 &velocity, std::vector<Request> &requests,
+		std::vector<int> &cancelled);
+	int allocateSlot(const glm::ivec2 &coordinate, SlotState state);
+	void freeSlot(int slot);
+	void evictOverBudget(std::vector<int> &released);
+};
+
+#endif
@@ -0,0 +1,37 @@
+#include "tile_random.h"
+
+static unsigned long long Mix64(unsigned long long x)
+{
+	x ^= x >> 30;
+	x *= 0xBF58476D1CE4E5B9ULL;
+	x ^= x >> 27;
+	x *= 0x94D049BB133111EBULL;
+	x ^= x >> 31;
+	return x;
+}
+
+unsigned CounterRandom(unsigned long long key, unsigned long long counter)
+{
+	// Weyl step per counter value, then a full avalanche of key and position
+	return (unsigned)(Mix64(key + (counter + 1) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+float CounterRandomUnit(unsigned long long key, unsigned long long counter)
+{
+	// Top 24 bits, exactly representable as a float below 1
+	return (CounterRandom(key, counter) >> 8) * (1.0f / 16777216.0f);
+}
+
+unsigned long long TileSeed(int tileX, int tileZ, unsigned stream)
+{
+	unsigned long long x = (unsigned)tileX;
+	unsigned long long z = (unsigned)tileZ;
+	return Mix64((x << 32 | z) ^ Mix64(stream + 0x632BE59BD9B4E019ULL));
+}
+
+int TileRandom::range(int min, int max)
+{
+	// Multiply-shift instead of %, so no value is favoured by low bits
+	unsigned long long span = (unsigned long long)((long long)max - min + 1);
+	return min + (int)((next() * span) >> 32);
+}
@@ -0,0 +1,33 @@
+#ifndef _TILE_RANDOM_H_
+#define _TILE_RANDOM_H_
+
+// Counter-based random numbers: value i of a stream is a pure function of
+// (key, i), so a tile's layout only depends on its coordinates, never on
+// which thread generated it or what was generated before.
+
+// Well-mixed 32 bits for a key and counter (SplitMix64 finaliser)
+unsigned CounterRandom(unsigned long long key, unsigned long long counter);
+
+// Same, mapped to [0, 1)
+float CounterRandomUnit(unsigned long long key, unsigned long long counter);
+
+// Key of the tile at integer tile coordinates; stream separates independent
+// sequences of the same tile (layout, colors, ...)
+unsigned long long TileSeed(int tileX, int tileZ, unsigned stream = 0);
+
+// Sequential draws from one key
+struct TileRandom {
+	unsigned long long key;
+	unsigned long long counter;
+
+	explicit TileRandom(unsigned long long key) : key(key), counter(0) {}
+
+	unsigned next() { return CounterRandom(key, counter++); }
+
+	// Uniform in [min, max], both inclusive
+	int range(int min, int max);
+
+	float unit() { return CounterRandomUnit(key, counter++); }
+};
+
+#endif
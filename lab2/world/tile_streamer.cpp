@@ -0,0 +1,177 @@
+#include "tile_streamer.h"
+
+#include <profile/profiler.h>
+
+void TileStreamer::start(unsigned workerCount)
+{
+	if (workerCount == 0) {
+		workerCount = 1;
+	}
+	stopping = false;
+	for (unsigned i = 0; i < workerCount; i++) {
+		workers.push_back(std::thread(&TileStreamer::workerLoop, this));
+	}
+}
+
+void TileStreamer::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		jobs.clear();
+	}
+	jobReady.notify_all();
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+	workers.clear();
+	results.clear();
+	outstanding.assign(outstanding.size(), false);
+}
+
+// Expects the mutex to be held
+void TileStreamer::dropQueuedJob(int slot)
+{
+	for (std::deque<Job>::iterator it = jobs.begin(); it != jobs.end(); ) {
+		if (it->slot == slot) {
+			it = jobs.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void TileStreamer::request(int slot, const glm::vec3 &offset, bool speculative)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (slot >= (int)generations.size()) {
+			generations.resize(slot + 1, 0);
+			outstanding.resize(slot + 1, false);
+		}
+
+		// Drop a queued job for this slot that has not started yet
+		dropQueuedJob(slot);
+
+		Job job;
+		job.slot = slot;
+		job.generation = ++generations[slot];
+		job.offset = offset;
+		job.speculative = speculative;
+		jobs.push_back(job);
+		outstanding[slot] = true;
+	}
+	jobReady.notify_one();
+}
+
+void TileStreamer::cancel(int slot)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (slot >= (int)generations.size()) {
+		return;
+	}
+	dropQueuedJob(slot);
+	++generations[slot];
+	outstanding[slot] = false;
+}
+
+void TileStreamer::promote(int slot)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (std::deque<Job>::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+		if (it->slot == slot) {
+			it->speculative = false;
+		}
+	}
+}
+
+bool TileStreamer::poll(int &slot, TileData &tile)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return popResult(slot, tile);
+}
+
+bool TileStreamer::wait(int &slot, TileData &tile)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!popResult(slot, tile)) {
+		if (!anyOutstanding()) {
+			return false;
+		}
+		resultReady.wait(lock);
+	}
+	return true;
+}
+
+// Expects the mutex to be held
+bool TileStreamer::popResult(int &slot, TileData &tile)
+{
+	while (!results.empty()) {
+		Result &result = results.front();
+		if (result.generation == generations[result.slot]) {
+			slot = result.slot;
+			std::swap(tile, result.tile);
+			outstanding[slot] = false;
+			results.pop_front();
+			return true;
+		}
+		results.pop_front();
+	}
+	return false;
+}
+
+// Expects the mutex to be held
+bool TileStreamer::anyOutstanding() const
+{
+	for (size_t i = 0; i < outstanding.size(); i++) {
+		if (outstanding[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void TileStreamer::workerLoop()
+{
+	PROFILE_THREAD("Tile worker");
+	for (;;) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while (jobs.empty() && !stopping) {
+				jobReady.wait(lock);
+			}
+			if (stopping) {
+				return;
+			}
+			// Oldest required job first, prefetches after
+			std::deque<Job>::iterator next = jobs.begin();
+			while (next != jobs.end() && next->speculative) {
+				++next;
+			}
+			if (next == jobs.end()) {
+				next = jobs.begin();
+			}
+			job = *next;
+			jobs.erase(next);
+		}
+
+		Result result;
+		result.slot = job.slot;
+		result.generation = job.generation;
+		GenerateTile(job.offset, result.tile);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stopping) {
+				return;
+			}
+			results.push_back(Result());
+			results.back().slot = result.slot;
+			results.back().generation = result.generation;
+			std::swap(results.back().tile, result.tile);
+		}
+		resultReady.notify_all();
+	}
+}
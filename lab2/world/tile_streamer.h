@@ -0,0 +1,70 @@
+#ifndef _TILE_STREAMER_H_
+#define _TILE_STREAMER_H_
+
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tile.h"
+
+// Generates tiles on worker threads. The render thread requests a tile for a
+// scene slot and later picks up the finished TileData with poll()/wait(), so
+// only the GL uploads are left on the main thread.
+struct TileStreamer {
+	struct Job {
+		int slot;
+		unsigned generation;
+		glm::vec3 offset;
+		bool speculative;
+	};
+	struct Result {
+		int slot;
+		unsigned generation;
+		TileData tile;
+	};
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobReady;
+	std::condition_variable resultReady;
+	std::deque<Job> jobs;
+	std::deque<Result> results;
+
+	// Latest requested generation per slot; results for older requests are dropped
+	std::vector<unsigned> generations;
+	std::vector<bool> outstanding;
+	bool stopping;
+
+	TileStreamer() : stopping(false) {}
+
+	void start(unsigned workerCount);
+	void stop();
+
+	// Queue generation of the tile at offset for a scene slot. A newer request
+	// for the same slot supersedes any older one still queued or in flight.
+	// Workers take speculative (prefetch) jobs only when nothing else waits.
+	void request(int slot, const glm::vec3 &offset, bool speculative = false);
+
+	// Forget the request of a slot; a result still in flight is dropped
+	void cancel(int slot);
+
+	// Turn a queued prefetch of a slot into a required job. It keeps its place
+	// in the queue, ahead of the required jobs requested after it.
+	void promote(int slot);
+
+	// Non-blocking: hands out one finished tile, false if none is ready
+	bool poll(int &slot, TileData &tile);
+
+	// Blocks until a requested tile is ready, false once nothing is outstanding
+	bool wait(int &slot, TileData &tile);
+
+	void workerLoop();
+	void dropQueuedJob(int slot);
+	bool popResult(int &slot, TileData &tile);
+	bool anyOutstanding() const;
+};
+
+#endif